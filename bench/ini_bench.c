@@ -0,0 +1,516 @@
+/*------------------------------------------------------------------------------
+ * SOURCE
+ *------------------------------------------------------------------------------
+ */
+
+/* Measures the parsing, the lookups and the saving of an INI file, usually generated by
+ * ini_generate (see the target bench of the Makefile). The results are written to the
+ * standard output as one JSON object per line, so they can be compared between commits
+ * and between the builds with and without the custom string allocator. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../ini_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef USE_POSIX_SYSTEM_CALLS
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#ifdef USE_CUSTOM_STRING_ALLOCATOR
+#define ALLOCATOR_NAME "custom"
+#else
+#define ALLOCATOR_NAME "malloc"
+#endif
+
+/* Number of lookups performed by each lookup benchmark */
+#define LOOKUP_OPERATIONS 1000000UL
+/* Number of distinct keys used by the benchmarks of missing keys */
+#define MISSING_KEYS 4096UL
+#define MAX_MISSING_KEY_SIZE 32
+/* Number of keys found by each call to ini_file_find_many */
+#define FIND_MANY_BATCH 100
+/* Largest number of threads used by the benchmark of ini_file_parse_parallel */
+#define MAX_PARSE_THREADS 8
+
+struct Query {
+    const char *section;
+    const char *key;
+};
+
+struct Flags_Variant {
+    const char *name;
+    int flags;
+};
+
+static const struct Flags_Variant variants[] = {
+    {"default", ini_default_flags},
+    {"bulk_load", ini_bulk_load},
+    {"hash_index", ini_hash_index},
+    {"memory_map", ini_memory_map},
+    {"intern_strings", ini_intern_strings}
+};
+
+/* The results of the lookups are accumulated here, so that they can't be optimized away */
+static volatile double sink;
+
+/*------------------------------------------------------------------------------
+ * UTILITIES
+ *------------------------------------------------------------------------------
+ */
+
+static double elapsed_seconds(void) {
+#ifdef USE_POSIX_SYSTEM_CALLS
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#else
+    return (double)clock() / (double)CLOCKS_PER_SEC;
+#endif
+}
+
+/* Returns the peak resident set size of the process in kilobytes, or zero if unknown */
+static long peak_memory_kb(void) {
+#ifdef USE_POSIX_SYSTEM_CALLS
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__) && defined(__MACH__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+/* Reads the size of the file and the number of lines it contains */
+static int measure_file(const char *const filename, size_t *const size, size_t *const lines) {
+    char buffer[BUFSIZ];
+    size_t read, i;
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    *size = 0;
+    *lines = 0;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        *size += read;
+        for (i = 0; i < read; i++) {
+            *lines += (buffer[i] == '\n');
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+/* Returns the number of processors available, or zero if unknown */
+static long processors_available(void) {
+#ifdef USE_POSIX_SYSTEM_CALLS
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return (processors > 0) ? processors : 0;
+#else
+    return 0;
+#endif
+}
+
+/* Deterministic shuffle, so that the lookups don't follow the order of the file */
+static void shuffle_queries(struct Query *const queries, const size_t size) {
+    unsigned long state = 1;
+    struct Query temp;
+    size_t i, j;
+    for (i = size; i > 1; i--) {
+        state = (state * 1664525UL + 1013904223UL) & 0xFFFFFFFFUL;
+        j = (size_t)(state >> 8) % i;
+        temp = queries[i - 1];
+        queries[i - 1] = queries[j];
+        queries[j] = temp;
+    }
+}
+
+/*------------------------------------------------------------------------------
+ * BENCHMARKS
+ *------------------------------------------------------------------------------
+ */
+
+static struct Ini_File *bench_parse(const char *const filename, const struct Flags_Variant *const variant,
+                                    const size_t size, const size_t lines, const unsigned long repeat) {
+    struct Ini_File *ini_file = NULL;
+    double start, seconds, best = 0.0;
+    unsigned long i;
+    for (i = 0; i < repeat; i++) {
+        ini_file_free(ini_file);
+        start = elapsed_seconds();
+        ini_file = ini_file_parse_with_flags(filename, variant->flags, NULL);
+        seconds = elapsed_seconds() - start;
+        if (ini_file == NULL) {
+            return NULL;
+        }
+        if ((i == 0) || (seconds < best)) {
+            best = seconds;
+        }
+    }
+    printf("{\"benchmark\": \"parse\", \"allocator\": \"%s\", \"flags\": \"%s\", \"bytes\": %lu, "
+           "\"lines\": %lu, \"seconds\": %.6f, \"mb_per_s\": %.2f, \"lines_per_s\": %.0f}\n",
+           ALLOCATOR_NAME, variant->name, (unsigned long)size, (unsigned long)lines, best,
+           (double)size / best / 1e6, (double)lines / best);
+    return ini_file;
+}
+
+/* Parses the file with ini_file_parse_parallel using 1, 2, 4 and 8 threads. The speedup is
+ * relative to the single thread, so it only shows the scaling when the number of processors
+ * reported is large enough. */
+static void bench_parse_parallel(const char *const filename, const size_t size, const unsigned long repeat) {
+    struct Ini_File *ini_file;
+    double start, seconds, best, single = 0.0;
+    unsigned long i;
+    size_t threads;
+    for (threads = 1; threads <= MAX_PARSE_THREADS; threads *= 2) {
+        best = 0.0;
+        for (i = 0; i < repeat; i++) {
+            start = elapsed_seconds();
+            ini_file = ini_file_parse_parallel(filename, threads, ini_default_flags, NULL);
+            seconds = elapsed_seconds() - start;
+            if (ini_file == NULL) {
+                fprintf(stderr, "It was not possible to parse the ini_file \"%s\" in parallel\n", filename);
+                return;
+            }
+            ini_file_free(ini_file);
+            if ((i == 0) || (seconds < best)) {
+                best = seconds;
+            }
+        }
+        if (threads == 1) {
+            single = best;
+        }
+        printf("{\"benchmark\": \"parse_parallel\", \"allocator\": \"%s\", \"threads\": %lu, "
+               "\"processors\": %ld, \"bytes\": %lu, \"seconds\": %.6f, \"mb_per_s\": %.2f, \"speedup\": %.2f}\n",
+               ALLOCATOR_NAME, (unsigned long)threads, processors_available(), (unsigned long)size, best,
+               (double)size / best / 1e6, single / best);
+    }
+}
+
+static void report_lookup(const char *const benchmark, const struct Flags_Variant *const variant,
+                          const char *const lookup_case, const double seconds) {
+    printf("{\"benchmark\": \"%s\", \"allocator\": \"%s\", \"flags\": \"%s\", \"case\": \"%s\", "
+           "\"operations\": %lu, \"ns_per_op\": %.2f}\n",
+           benchmark, ALLOCATOR_NAME, variant->name, lookup_case, LOOKUP_OPERATIONS,
+           seconds * 1e9 / (double)LOOKUP_OPERATIONS);
+}
+
+/* Tells if the query is used by the lookup of the given type. The types of the values are
+ * given by the first letter of the keys (see ini_generate), while the missing keys are
+ * used by all the lookups. */
+static int is_query_of_type(const struct Query *const query, const char type, const int miss) {
+    return miss || (type == '\0') || (query->key[0] == type);
+}
+
+/* Runs LOOKUP_OPERATIONS lookups of the queries with each find function */
+static void bench_lookups(struct Ini_File *const ini_file, const struct Flags_Variant *const variant,
+                          const struct Query *const queries, const size_t size, const int miss) {
+    static const char *const benchmarks[] = {"find_property", "find_integer", "find_double"};
+    static const char types[] = {'\0', 'i', 'd'};
+    Ini_File_Error error;
+    double start, total;
+    char *value;
+    long integer;
+    double real;
+    unsigned long operation;
+    size_t i, j;
+    for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        for (j = 0; (j < size) && !is_query_of_type(&queries[j], types[i], miss); j++);
+        if (j == size) {
+            continue;
+        }
+        total = 0.0;
+        start = elapsed_seconds();
+        for (operation = 0; operation < LOOKUP_OPERATIONS; j = (j + 1) % size) {
+            if (!is_query_of_type(&queries[j], types[i], miss)) {
+                continue;
+            }
+            switch (i) {
+            case 0:
+                error = ini_file_find_property(ini_file, queries[j].section, queries[j].key, &value);
+                total += (error == ini_no_error) ? (double)value[0] : 0.0;
+                break;
+            case 1:
+                error = ini_file_find_integer(ini_file, queries[j].section, queries[j].key, &integer);
+                total += (error == ini_no_error) ? (double)integer : 0.0;
+                break;
+            default:
+                error = ini_file_find_double(ini_file, queries[j].section, queries[j].key, &real);
+                total += (error == ini_no_error) ? real : 0.0;
+                break;
+            }
+            operation++;
+        }
+        report_lookup(benchmarks[i], variant, miss ? "miss" : "hit", elapsed_seconds() - start);
+        sink += total;
+    }
+}
+
+/* Runs LOOKUP_OPERATIONS reads of the integer properties through the handles resolved once */
+static void bench_handles(struct Ini_File *const ini_file, const struct Flags_Variant *const variant,
+                          const struct Query *const queries, const size_t size) {
+    Ini_Handle *handles = malloc(size * sizeof(Ini_Handle));
+    double start, total = 0.0;
+    long integer;
+    unsigned long operation;
+    size_t i, handles_size = 0;
+    if (handles == NULL) {
+        return;
+    }
+    for (i = 0; i < size; i++) {
+        if (is_query_of_type(&queries[i], 'i', 0) &&
+            (ini_file_resolve(ini_file, queries[i].section, queries[i].key, &handles[handles_size]) == ini_no_error)) {
+            handles_size++;
+        }
+    }
+    if (handles_size > 0) {
+        start = elapsed_seconds();
+        for (operation = 0, i = 0; operation < LOOKUP_OPERATIONS; operation++, i = (i + 1) % handles_size) {
+            if (ini_handle_get_integer(ini_file, &handles[i], &integer) == ini_no_error) {
+                total += (double)integer;
+            }
+        }
+        report_lookup("handle_get_integer", variant, "hit", elapsed_seconds() - start);
+        sink += total;
+    }
+    free(handles);
+}
+
+/* Finds LOOKUP_OPERATIONS properties with ini_file_find_many, in batches of the keys of the
+ * same section, as done when a module reads its settings */
+static void bench_find_many(struct Ini_File *const ini_file, const struct Flags_Variant *const variant) {
+    Ini_Query queries[FIND_MANY_BATCH];
+    const struct Ini_Section *section;
+    double start;
+    unsigned long operation = 0;
+    size_t i = 0, j, size;
+    if (ini_file->sections_size == 0) {
+        return;
+    }
+    start = elapsed_seconds();
+    while (operation < LOOKUP_OPERATIONS) {
+        section = &ini_file->sections[i++ % ini_file->sections_size];
+        size = (section->properties_size < FIND_MANY_BATCH) ? section->properties_size : FIND_MANY_BATCH;
+        for (j = 0; j < size; j++) {
+            queries[j].section = section->name;
+            queries[j].key = section->properties[size - j - 1].key;
+            queries[j].type = ini_value_string;
+            queries[j].result = NULL;
+        }
+        ini_file_find_many(ini_file, queries, size);
+        operation += size + (size == 0);
+    }
+    report_lookup("find_many", variant, "hit", elapsed_seconds() - start);
+}
+
+/* Converts LOOKUP_OPERATIONS values of the integer and double properties, using the
+ * conversions of the library and the functions of the C library */
+static void bench_conversions(struct Ini_File *const ini_file, const struct Query *const queries, const size_t size) {
+    static const char *const benchmarks[] = {"convert_integer", "convert_double"};
+    static const char types[] = {'i', 'd'};
+    char **values = malloc(size * sizeof(char *));
+    double start, total;
+    unsigned long operation;
+    size_t i, j, values_size;
+    int libc;
+    if (values == NULL) {
+        return;
+    }
+    for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        for (j = 0, values_size = 0; j < size; j++) {
+            if (is_query_of_type(&queries[j], types[i], 0) &&
+                (ini_file_find_property(ini_file, queries[j].section, queries[j].key, &values[values_size]) == ini_no_error)) {
+                values_size++;
+            }
+        }
+        for (libc = 0; (libc < 2) && (values_size > 0); libc++) {
+            long integer = 0;
+            double real = 0.0;
+            total = 0.0;
+            start = elapsed_seconds();
+            for (operation = 0, j = 0; operation < LOOKUP_OPERATIONS; operation++, j = (j + 1) % values_size) {
+                if (i == 0) {
+                    if (libc) {
+                        integer = strtol(values[j], NULL, 10);
+                    } else {
+                        ini_convert_integer(values[j], strlen(values[j]), &integer);
+                    }
+                    total += (double)integer;
+                } else {
+                    if (libc) {
+                        real = strtod(values[j], NULL);
+                    } else {
+                        ini_convert_double(values[j], strlen(values[j]), &real);
+                    }
+                    total += real;
+                }
+            }
+            printf("{\"benchmark\": \"%s\", \"allocator\": \"%s\", \"implementation\": \"%s\", "
+                   "\"operations\": %lu, \"ns_per_op\": %.2f}\n",
+                   benchmarks[i], ALLOCATOR_NAME, libc ? "libc" : "ini", LOOKUP_OPERATIONS,
+                   (elapsed_seconds() - start) * 1e9 / (double)LOOKUP_OPERATIONS);
+            sink += total;
+        }
+    }
+    free(values);
+}
+
+static void bench_save(const struct Ini_File *const ini_file, const char *const filename, const unsigned long repeat) {
+    double start, seconds, best_save = 0.0, best_serialize = 0.0;
+    size_t size = ini_file_serialized_size(ini_file);
+    char *buffer = malloc(size + 1);
+    unsigned long i;
+    if (buffer == NULL) {
+        return;
+    }
+    for (i = 0; i < repeat; i++) {
+        start = elapsed_seconds();
+        if (ini_file_serialize_to_buffer(ini_file, buffer, size + 1, &size) != ini_no_error) {
+            break;
+        }
+        seconds = elapsed_seconds() - start;
+        if ((i == 0) || (seconds < best_serialize)) {
+            best_serialize = seconds;
+        }
+        start = elapsed_seconds();
+        if (ini_file_save(ini_file, filename) != ini_no_error) {
+            break;
+        }
+        seconds = elapsed_seconds() - start;
+        if ((i == 0) || (seconds < best_save)) {
+            best_save = seconds;
+        }
+    }
+    free(buffer);
+    remove(filename);
+    if (i < repeat) {
+        fprintf(stderr, "It was not possible to save the file \"%s\"\n", filename);
+        return;
+    }
+    printf("{\"benchmark\": \"serialize\", \"allocator\": \"%s\", \"bytes\": %lu, \"seconds\": %.6f, "
+           "\"mb_per_s\": %.2f}\n",
+           ALLOCATOR_NAME, (unsigned long)size, best_serialize, (double)size / best_serialize / 1e6);
+    printf("{\"benchmark\": \"save\", \"allocator\": \"%s\", \"bytes\": %lu, \"seconds\": %.6f, "
+           "\"mb_per_s\": %.2f}\n",
+           ALLOCATOR_NAME, (unsigned long)size, best_save, (double)size / best_save / 1e6);
+}
+
+/*------------------------------------------------------------------------------
+ * MAIN
+ *------------------------------------------------------------------------------
+ */
+
+int main(const int argc, const char **const argv) {
+    struct Ini_File *ini_file;
+    struct Ini_File_Stats stats;
+    struct Ini_Section *section;
+    struct Query *hits, *misses;
+    char *missing_keys, *save_filename;
+    size_t file_size, lines, hits_size, misses_size, i, j;
+    unsigned long repeat = 5;
+    long memory_before, memory_after;
+    if ((argc < 2) || (argc > 3) || ((argc == 3) && ((repeat = strtoul(argv[2], NULL, 10)) == 0))) {
+        fprintf(stderr, "Usage: %s ini_file_name [repetitions]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!measure_file(argv[1], &file_size, &lines)) {
+        fprintf(stderr, "It was not possible to open the file \"%s\"\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    /* The memory is measured first, when the peak is still due to the parsing alone */
+    memory_before = peak_memory_kb();
+    ini_file = ini_file_parse(argv[1], NULL);
+    memory_after = peak_memory_kb();
+    if (ini_file == NULL) {
+        fprintf(stderr, "It was not possible to parse the ini_file \"%s\"\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    ini_file_stats(ini_file, &stats);
+    printf("{\"benchmark\": \"memory\", \"allocator\": \"%s\", \"bytes\": %lu, \"peak_rss_kb\": %ld, "
+           "\"parse_rss_kb\": %ld, \"allocations\": %lu, \"arena_size\": %lu, \"arena_wasted\": %lu, "
+           "\"bytes_moved\": %lu, \"capacity_slack\": %lu}\n",
+           ALLOCATOR_NAME, (unsigned long)file_size, memory_after, memory_after - memory_before,
+           (unsigned long)stats.allocations, (unsigned long)stats.arena_size, (unsigned long)stats.arena_wasted,
+           (unsigned long)stats.bytes_moved, (unsigned long)stats.capacity_slack);
+    ini_file_free(ini_file);
+    /* The queries reference the strings of the file parsed with the default flags */
+    ini_file = bench_parse(argv[1], &variants[0], file_size, lines, repeat);
+    if (ini_file == NULL) {
+        fprintf(stderr, "It was not possible to parse the ini_file \"%s\"\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    hits_size = ini_file->global_section.properties_size;
+    for (i = 0; i < ini_file->sections_size; i++) {
+        hits_size += ini_file->sections[i].properties_size;
+    }
+    misses_size = MISSING_KEYS;
+    hits = malloc((hits_size + 1) * sizeof(struct Query));
+    misses = malloc(misses_size * sizeof(struct Query));
+    missing_keys = malloc(misses_size * MAX_MISSING_KEY_SIZE);
+    save_filename = malloc(strlen(argv[1]) + sizeof(".save"));
+    if ((hits == NULL) || (misses == NULL) || (missing_keys == NULL) || (save_filename == NULL)) {
+        fprintf(stderr, "It was not possible to allocate the queries\n");
+        return EXIT_FAILURE;
+    }
+    hits_size = 0;
+    for (i = 0; i <= ini_file->sections_size; i++) {
+        section = (i == 0) ? &ini_file->global_section : &ini_file->sections[i - 1];
+        for (j = 0; j < section->properties_size; j++) {
+            hits[hits_size].section = section->name;
+            hits[hits_size].key = section->properties[j].key;
+            hits_size++;
+        }
+    }
+    shuffle_queries(hits, hits_size);
+    /* The missing keys are searched in existing sections, so that the properties are searched */
+    for (i = 0; i < misses_size; i++) {
+        section = (ini_file->sections_size == 0) ? &ini_file->global_section : &ini_file->sections[i % ini_file->sections_size];
+        sprintf(&missing_keys[i * MAX_MISSING_KEY_SIZE], "missing_%lu", (unsigned long)i);
+        misses[i].section = section->name;
+        misses[i].key = &missing_keys[i * MAX_MISSING_KEY_SIZE];
+    }
+    for (i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        struct Ini_File *parsed = (i == 0) ? ini_file : bench_parse(argv[1], &variants[i], file_size, lines, repeat);
+        if (parsed == NULL) {
+            fprintf(stderr, "It was not possible to parse the ini_file \"%s\"\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+        if ((variants[i].flags == ini_default_flags) || (variants[i].flags == ini_hash_index)) {
+            if (hits_size > 0) {
+                bench_lookups(parsed, &variants[i], hits, hits_size, 0);
+                bench_handles(parsed, &variants[i], hits, hits_size);
+                bench_find_many(parsed, &variants[i]);
+            }
+            bench_lookups(parsed, &variants[i], misses, misses_size, 1);
+        }
+        if (parsed != ini_file) {
+            ini_file_free(parsed);
+        }
+    }
+    bench_parse_parallel(argv[1], file_size, repeat);
+    bench_conversions(ini_file, hits, hits_size);
+    strcpy(save_filename, argv[1]);
+    strcat(save_filename, ".save");
+    bench_save(ini_file, save_filename, repeat);
+    ini_file_free(ini_file);
+    free(hits);
+    free(misses);
+    free(missing_keys);
+    free(save_filename);
+    return EXIT_SUCCESS;
+}
+
+/*------------------------------------------------------------------------------
+ * END
+ *------------------------------------------------------------------------------
+ */
@@ -0,0 +1,99 @@
+/*------------------------------------------------------------------------------
+ * SOURCE
+ *------------------------------------------------------------------------------
+ */
+
+/* Generates a synthetic INI file used by the benchmarks. The output depends only on
+ * the arguments, so the same file is produced on every run and on every machine.
+ * The keys are prefixed by the type of their values ("i" for integers, "d" for
+ * doubles and "s" for strings), which is used by ini_bench to choose the queries. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*------------------------------------------------------------------------------
+ * PSEUDO-RANDOM NUMBER GENERATOR
+ *------------------------------------------------------------------------------
+ */
+
+/* Linear congruential generator with the constants of Numerical Recipes. It's
+ * implemented here because the sequence of rand() changes between C libraries. */
+static unsigned long random_state;
+
+static unsigned long random_next(void) {
+    random_state = (random_state * 1664525UL + 1013904223UL) & 0xFFFFFFFFUL;
+    return random_state >> 8;
+}
+
+static void random_text(FILE *const file, const unsigned long len) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789_";
+    unsigned long i;
+    for (i = 0; i < len; i++) {
+        fputc(alphabet[random_next() % (sizeof(alphabet) - 1)], file);
+    }
+}
+
+/*------------------------------------------------------------------------------
+ * MAIN
+ *------------------------------------------------------------------------------
+ */
+
+static int parse_argument(const char *const arg, unsigned long *const value) {
+    char *end;
+    *value = strtoul(arg, &end, 10);
+    return (*end == '\0') && (end != arg);
+}
+
+int main(const int argc, const char **const argv) {
+    unsigned long sections, keys, key_len, value_len, seed;
+    unsigned long section, key;
+    int written;
+    FILE *file;
+    if ((argc != 7) || !parse_argument(argv[1], &sections) || !parse_argument(argv[2], &keys) ||
+        !parse_argument(argv[3], &key_len) || !parse_argument(argv[4], &value_len) ||
+        !parse_argument(argv[5], &seed)) {
+        fprintf(stderr, "Usage: %s sections keys_per_section key_len value_len seed output\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    file = fopen(argv[6], "w");
+    if (file == NULL) {
+        fprintf(stderr, "It was not possible to create the file \"%s\"\n", argv[6]);
+        return EXIT_FAILURE;
+    }
+    random_state = seed;
+    fprintf(file, "; Synthetic INI file: %lu sections, %lu keys per section, seed %lu\n",
+            sections, keys, seed);
+    for (section = 0; section < sections; section++) {
+        fprintf(file, "\n[section_%lu]\n", section);
+        for (key = 0; key < keys; key++) {
+            /* The prefix keeps the keys unique, the random text pads them up to key_len */
+            written = fprintf(file, "%c%lu_", "ids"[key % 3], key);
+            if ((written > 0) && ((unsigned long)written < key_len)) {
+                random_text(file, key_len - (unsigned long)written);
+            }
+            fputs(" = ", file);
+            switch (key % 3) {
+            case 0:
+                fprintf(file, "%ld", (long)random_next() - 0x800000L);
+                break;
+            case 1:
+                fprintf(file, "%lu.%06lu", random_next() % 100000UL, random_next() % 1000000UL);
+                break;
+            default:
+                random_text(file, value_len);
+                break;
+            }
+            fputc('\n', file);
+        }
+    }
+    if (fclose(file) != 0) {
+        fprintf(stderr, "It was not possible to write the file \"%s\"\n", argv[6]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/*------------------------------------------------------------------------------
+ * END
+ *------------------------------------------------------------------------------
+ */
@@ -26,26 +26,189 @@
  *------------------------------------------------------------------------------
  */
 
-#include <ctype.h>
+/* Required to access the POSIX system calls when compiling with -std=c89 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "ini_file.h"
 
+/* The tokenizer of the parser compares blocks of 32 (AVX2) or 16 bytes (SSE2) at once,
+ * if these instruction sets are available at compile time. Otherwise, a portable
+ * implementation that classifies one byte at a time is used. */
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#define USE_VECTORIZED_SCANNER
+#define SCANNER_BLOCK_SIZE 32
+typedef __m256i Scanner_Block;
+#define scanner_load(ptr) _mm256_loadu_si256((const __m256i *)(ptr))
+#define scanner_broadcast(c) _mm256_set1_epi8(c)
+#define scanner_zero() _mm256_setzero_si256()
+#define scanner_or(a, b) _mm256_or_si256(a, b)
+#define scanner_equals(a, b) _mm256_cmpeq_epi8(a, b)
+#define scanner_mask(a) ((unsigned int)_mm256_movemask_epi8(a))
+#elif defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_VECTORIZED_SCANNER
+#define SCANNER_BLOCK_SIZE 16
+typedef __m128i Scanner_Block;
+#define scanner_load(ptr) _mm_loadu_si128((const __m128i *)(ptr))
+#define scanner_broadcast(c) _mm_set1_epi8(c)
+#define scanner_zero() _mm_setzero_si128()
+#define scanner_or(a, b) _mm_or_si128(a, b)
+#define scanner_equals(a, b) _mm_cmpeq_epi8(a, b)
+#define scanner_mask(a) ((unsigned int)_mm_movemask_epi8(a))
+#endif
+
+#ifdef USE_POSIX_THREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef USE_POSIX_SYSTEM_CALLS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef USE_ATOMIC_OPERATIONS
+/* Atomic operations used to publish the snapshots to other threads and processes */
+#define atomic_load(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define atomic_store(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST)
+#define atomic_add(ptr, value) __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST)
+#define atomic_sub(ptr, value) __atomic_fetch_sub(ptr, value, __ATOMIC_SEQ_CST)
+#define atomic_compare_exchange(ptr, expected, desired) __atomic_compare_exchange_n(ptr, expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+/* The atomic operations are required to fill the cache of the converted values safely
+ * when the same structure is read by several threads */
+#define USE_VALUE_CACHE
+#endif
+
 /* Most systems do not allow for a line greather than 4 kbytes */
 #define MAX_LINE_SIZE 4096
 
+/* Size of the chunks in which the files are read */
+#define READ_BUFFER_SIZE 65536
+
 #define INITIAL_SECTIONS_CAPACITY 32
 #define INITIAL_PROPERTIES_CAPACITY 32
+#define INITIAL_INDEX_CAPACITY 64
+#define INITIAL_FREE_STRINGS_CAPACITY 16
+
+static size_t max_size(const size_t a, const size_t b) {
+    return ((a > b) ? a : b);
+}
+
+static size_t hash_sized_string(const char *const str, const size_t len) {
+    unsigned long hash = 2166136261UL;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619UL;
+    }
+    return (size_t)hash;
+}
+
+#define array_resize(array, default_cap) \
+    do { \
+        if ((array ## _size + 1) >= array ## _capacity) { \
+            const size_t new_cap = max_size(2 * array ## _capacity, default_cap); \
+            void *const new_array = realloc(array, new_cap * sizeof(*array)); \
+            if (new_array == NULL) { \
+                return ini_allocation; \
+            } \
+            array = new_array; \
+            array ## _capacity = new_cap; \
+        } \
+    } while (0)
+
+/* Same as array_resize, but for the arrays owned by the ini_file, which use its allocator */
+#define ini_file_array_resize(ini_file, array, default_cap) \
+    do { \
+        if ((array ## _size + 1) >= array ## _capacity) { \
+            const size_t new_cap = max_size(2 * array ## _capacity, default_cap); \
+            void *const new_array = ini_reallocate(ini_file, array, new_cap * sizeof(*array)); \
+            if (new_array == NULL) { \
+                return ini_allocation; \
+            } \
+            array = new_array; \
+            array ## _capacity = new_cap; \
+        } \
+    } while (0)
+
+/* Monotonic clock used to measure the parsing time reported by ini_file_stats */
+static double current_seconds(void) {
+#ifdef USE_POSIX_SYSTEM_CALLS
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+        return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+    }
+#endif
+    return (double)clock() / (double)CLOCKS_PER_SEC;
+}
+
+static void *default_allocate(void *const context, const size_t size) {
+    (void)context;
+    return malloc(size);
+}
+
+static void *default_reallocate(void *const context, void *const ptr, const size_t size) {
+    (void)context;
+    return realloc(ptr, size);
+}
+
+static void default_release(void *const context, void *const ptr) {
+    (void)context;
+    free(ptr);
+}
+
+static const struct Ini_Allocator default_allocator = {default_allocate, default_reallocate, default_release, NULL};
+
+/* All the memory owned by an Ini_File is managed by these functions, which use its allocator.
+ * The allocations are counted for the statistics reported by ini_file_stats. */
+static void *ini_allocate(struct Ini_File *const ini_file, const size_t size) {
+    void *const ptr = ini_file->allocator.allocate(ini_file->allocator.context, size);
+    ini_file->allocations += (ptr != NULL);
+    return ptr;
+}
+
+static void *ini_allocate_zeroed(struct Ini_File *const ini_file, const size_t size) {
+    void *const ptr = ini_allocate(ini_file, size);
+    if (ptr != NULL) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+static void *ini_reallocate(struct Ini_File *const ini_file, void *const ptr, const size_t size) {
+    void *const new_ptr = ini_file->allocator.reallocate(ini_file->allocator.context, ptr, size);
+    ini_file->allocations += (new_ptr != NULL);
+    return new_ptr;
+}
+
+static void ini_release(const struct Ini_File *const ini_file, void *const ptr) {
+    if (ptr != NULL) {
+        ini_file->allocator.release(ini_file->allocator.context, ptr);
+    }
+}
 
 #ifdef USE_CUSTOM_STRING_ALLOCATOR
-static void string_buffer_free(struct String_Buffer *buffer) {
-    if (buffer == NULL) {
-        return;
+/* The strings are stored right after the header of the buffers */
+#define string_buffer_data(buffer) ((char *)((buffer) + 1))
+
+static void string_buffer_free(const struct Ini_File *const ini_file, struct String_Buffer *buffer) {
+    while (buffer != NULL) {
+        struct String_Buffer *const next = buffer->next;
+        ini_release(ini_file, buffer);
+        buffer = next;
     }
-    string_buffer_free(buffer->next);
-    free(buffer);
 }
 #endif
 
@@ -80,42 +243,423 @@ char *get_content_from_file(const char *const filename) {
 	return buffer;
 }
 
-struct Ini_File *ini_file_new(void) {
-    struct Ini_File *ini_file = malloc(sizeof(struct Ini_File));
+/* Maps the whole file in memory (read-only). Empty files result in a NULL pointer.
+ * If the system doesn't support memory-mapped files, the file is read to a buffer. */
+static Ini_File_Error map_file(const char *const filename, char **const data, size_t *const size) {
+#ifdef USE_POSIX_SYSTEM_CALLS
+    struct stat file_status;
+    void *mapping;
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return ini_couldnt_open_file;
+    }
+    if ((fstat(fd, &file_status) != 0) || !S_ISREG(file_status.st_mode)) {
+        close(fd);
+        return ini_couldnt_open_file;
+    }
+    *data = NULL;
+    *size = (size_t)file_status.st_size;
+    if (*size > 0) {
+        mapping = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return ini_allocation;
+        }
+        /* The file is read only once from the beginning to the end */
+        posix_madvise(mapping, *size, POSIX_MADV_SEQUENTIAL);
+        *data = mapping;
+    }
+    close(fd);
+    return ini_no_error;
+#else
+    FILE *const file = fopen(filename, "rb");
+    if (file == NULL) {
+        return ini_couldnt_open_file;
+    }
+    *data = NULL;
+    *size = get_file_size(file);
+    if (*size > 0) {
+        *data = malloc(*size);
+        if (*data == NULL) {
+            fclose(file);
+            return ini_allocation;
+        }
+        if (fread(*data, sizeof(char), *size, file) != *size) {
+            free(*data);
+            fclose(file);
+            return ini_couldnt_open_file;
+        }
+    }
+    fclose(file);
+    return ini_no_error;
+#endif
+}
+
+static void unmap_file(char *const data, const size_t size) {
+    if (data == NULL) {
+        return;
+    }
+#ifdef USE_POSIX_SYSTEM_CALLS
+    munmap(data, size);
+#else
+    (void)size;
+    free(data);
+#endif
+}
+
+struct Ini_File *ini_file_new_with_allocator(const struct Ini_Allocator *allocator) {
+    struct Ini_File *ini_file;
+    if (allocator == NULL) {
+        allocator = &default_allocator;
+    } else if ((allocator->allocate == NULL) || (allocator->reallocate == NULL) || (allocator->release == NULL)) {
+        return NULL;
+    }
+    ini_file = allocator->allocate(allocator->context, sizeof(struct Ini_File));
     if (ini_file == NULL) {
         return NULL;
     }
     memset(ini_file, 0, sizeof(struct Ini_File));
     ini_file->current_section = &ini_file->global_section;
+    ini_file->allocator = *allocator;
+    ini_file->allocations = 1;
     return ini_file;
 }
 
-static void ini_section_free(struct Ini_Section *const ini_section) {
-#ifndef USE_CUSTOM_STRING_ALLOCATOR
+struct Ini_File *ini_file_new(void) {
+    return ini_file_new_with_allocator(NULL);
+}
+
+/* State of the allocators created by ini_allocator_from_region, which is stored at the
+ * beginning of the region. Each block is preceded by its size, so it can be reallocated. */
+struct Ini_Region {
+    char *memory;
+    size_t size;
+    size_t used;
+    /* The last block allocated can be expanded and released in place */
+    char *last;
+};
+
+/* The blocks are aligned as any of these types */
+union Ini_Region_Alignment {
+    long integer;
+    double real;
+    void *pointer;
+    size_t size;
+};
+
+#define REGION_ALIGNMENT sizeof(union Ini_Region_Alignment)
+#define region_align(size) (((size) + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT * REGION_ALIGNMENT)
+#define region_block_size(block) (*(size_t *)((block) - region_align(sizeof(size_t))))
+
+static void *region_allocate(void *const context, const size_t size) {
+    struct Ini_Region *const region = context;
+    const size_t block_size = region_align(sizeof(size_t)) + region_align(size);
+    if ((size > region->size) || (block_size > (region->size - region->used))) {
+        return NULL;
+    }
+    region->last = &region->memory[region->used + region_align(sizeof(size_t))];
+    region->used += block_size;
+    region_block_size(region->last) = size;
+    return region->last;
+}
+
+static void *region_reallocate(void *const context, void *const ptr, const size_t size) {
+    struct Ini_Region *const region = context;
+    char *const block = ptr;
+    char *new_block;
+    if (block == NULL) {
+        return region_allocate(context, size);
+    }
+    if (block == region->last) {
+        const size_t start = (size_t)(block - region->memory);
+        if ((size > region->size) || (region_align(size) > (region->size - start))) {
+            return NULL;
+        }
+        region->used = start + region_align(size);
+        region_block_size(block) = size;
+        return block;
+    }
+    if (size <= region_block_size(block)) {
+        return block;
+    }
+    new_block = region_allocate(context, size);
+    if (new_block != NULL) {
+        memcpy(new_block, block, region_block_size(block));
+    }
+    return new_block;
+}
+
+static void region_release(void *const context, void *const ptr) {
+    struct Ini_Region *const region = context;
+    if ((ptr != NULL) && (ptr == region->last)) {
+        region->used = (size_t)(region->last - region->memory) - region_align(sizeof(size_t));
+        region->last = NULL;
+    }
+}
+
+Ini_File_Error ini_allocator_from_region(struct Ini_Allocator *const allocator, void *const memory, const size_t size) {
+    struct Ini_Region *region;
+    /* The state of the allocator must be aligned too */
+    const size_t padding = (REGION_ALIGNMENT - (size_t)memory % REGION_ALIGNMENT) % REGION_ALIGNMENT;
+    const size_t header = padding + region_align(sizeof(struct Ini_Region));
+    if ((allocator == NULL) || (memory == NULL) || (size <= header)) {
+        return ini_invalid_parameters;
+    }
+    region = (struct Ini_Region *)((char *)memory + padding);
+    region->memory = (char *)memory + header;
+    region->size = size - header;
+    region->used = 0;
+    region->last = NULL;
+    allocator->allocate = region_allocate;
+    allocator->reallocate = region_reallocate;
+    allocator->release = region_release;
+    allocator->context = region;
+    return ini_no_error;
+}
+
+#ifdef USE_CUSTOM_STRING_ALLOCATOR
+/* The strings are allocated in size classes: the strings smaller than 8 bytes have their
+ * own classes, and there are eight classes for each power of two after that (8, 9, ..., 15,
+ * 16, 18, ..., 30, 32, 36, ...). So a released string can be reused by any other string of
+ * the same class, while wasting less than an eighth of the memory. Returns the index of the
+ * class of the string and stores its size at size. The classes cover the strings up to 1 MB,
+ * the larger ones are never reused. */
+#define STRING_SIZE_CLASSES 143
+
+struct String_Free_List {
+    char **strings;
+    size_t strings_size;
+    size_t strings_capacity;
+};
+
+static size_t string_size_class(const size_t len, size_t *const size) {
+    const size_t min_size = len + 1;
+    size_t exponent = 3, step;
+    if (min_size < 8) {
+        *size = min_size;
+        return min_size - 1;
+    }
+    while ((min_size >> (exponent + 1)) != 0) {
+        exponent++;
+    }
+    step = (size_t)1 << (exponent - 3);
+    *size = (min_size + step - 1) & ~(step - 1);
+    return 7 + 8 * (exponent - 3) + (*size / step) - 8;
+}
+
+/* Inverse of string_size_class: returns the size of the strings of the class */
+static size_t string_class_size(const size_t size_class) {
+    if (size_class < 7) {
+        return size_class + 1;
+    }
+    return (8 + (size_class - 7) % 8) << ((size_class - 7) / 8);
+}
+
+static Ini_File_Error string_free_list_push(struct Ini_File *const ini_file, struct String_Free_List *const free_list, char *const str) {
+    ini_file_array_resize(ini_file, free_list->strings, INITIAL_FREE_STRINGS_CAPACITY);
+    free_list->strings[free_list->strings_size++] = str;
+    return ini_no_error;
+}
+
+/* Inserts the string in the free list of the class. The table of free lists is allocated
+ * when needed. Returns zero if the string couldn't be inserted. */
+static int string_free_list_insert(struct Ini_File *const ini_file, const size_t size_class, char *const str) {
+    if (ini_file->free_strings == NULL) {
+        ini_file->free_strings = ini_allocate_zeroed(ini_file, STRING_SIZE_CLASSES * sizeof(struct String_Free_List));
+        if (ini_file->free_strings == NULL) {
+            return 0;
+        }
+    }
+    return (string_free_list_push(ini_file, &ini_file->free_strings[size_class], str) == ini_no_error);
+}
+
+/* Keeps the space left at the end of a buffer in the free list of the largest class that fits
+ * in it, so it can be reused by the next strings. Only the remaining bytes are wasted. */
+static void string_retire_space(struct Ini_File *const ini_file, char *const space, const size_t space_size) {
+    size_t size_class, size;
+    if (space_size == 0) {
+        return;
+    }
+    size_class = string_size_class(space_size - 1, &size);
+    if (size > space_size) {
+        size_class--;
+    }
+    if (size_class >= STRING_SIZE_CLASSES) {
+        size_class = STRING_SIZE_CLASSES - 1;
+    }
+    size = string_class_size(size_class);
+    if (!string_free_list_insert(ini_file, size_class, space)) {
+        size = 0;
+    }
+    ini_file->strings_wasted += space_size - size;
+}
+#endif
+
+/* Strings stored in the interning mode (see the flag ini_intern_strings). The table uses open
+ * addressing with linear probing, its capacity is a power of two and it's kept at least twice
+ * the number of strings. The empty slots have a NULL string. */
+struct Interned_String {
+    char *str;
+    size_t len;
+    size_t hash;
+};
+
+/* Releases a string stored by copy_sized_string. The custom string allocator keeps it in
+ * the free list of its size class, so its memory can be reused by the next strings stored.
+ * If the free list can't be allocated, the string is only released with the buffers. */
+static void release_string(struct Ini_File *const ini_file, char *const str, const size_t len) {
+#ifdef USE_CUSTOM_STRING_ALLOCATOR
+    size_t size_class, size;
+    if ((str == NULL) || (ini_file->flags & ini_zero_copy)) {
+        return;
+    }
+    size_class = string_size_class(len, &size);
+    if (size_class < STRING_SIZE_CLASSES) {
+        string_free_list_insert(ini_file, size_class, str);
+    }
+#else
+    (void)len;
+    if (!(ini_file->flags & ini_zero_copy)) {
+        ini_release(ini_file, str);
+    }
+#endif
+}
+
+/* Releases a string stored by store_sized_string. In the interning mode the strings may be
+ * shared, so they are only released with the structure. */
+static void free_string(struct Ini_File *const ini_file, char *const str, const size_t len) {
+    if (!(ini_file->flags & ini_intern_strings)) {
+        release_string(ini_file, str, len);
+    }
+}
+
+/* Value converted by the find functions, stored in the cache of the section (see
+ * Ini_Section::cached_values). Its type is one of enum Ini_Cached_Type, whose first
+ * element (cached_none) is zero, so the cache is cleared by filling it with zeros. */
+struct Ini_Cached_Value {
+    union {
+        long integer;
+        unsigned long uint;
+        double real;
+        int boolean;
+    } value;
+    int cached_type;
+};
+
+/* The cache has the same capacity as the array of properties, and its elements are moved
+ * with the properties. It's allocated and resized only by the functions that modify the
+ * structure, which never run at the same time as the find functions, so it uses the
+ * allocator of the structure like its other arrays, and the find functions only read it. */
+static void ini_section_release_cache(const struct Ini_File *const ini_file, struct Ini_Section *const ini_section) {
+    ini_release(ini_file, ini_section->cached_values);
+    ini_section->cached_values = NULL;
+}
+
+/* Allocates the cache, or resizes it to the capacity of the properties, given the capacity
+ * it was allocated with (cached_capacity). If it can't be allocated, the values are just
+ * converted by the find functions. */
+static void ini_section_reserve_cache(struct Ini_File *const ini_file, struct Ini_Section *const ini_section, const size_t cached_capacity) {
+#ifdef USE_VALUE_CACHE
+    struct Ini_Cached_Value *cached_values;
+    if (ini_section->properties_capacity == 0) {
+        return;
+    }
+    if (ini_section->cached_values == NULL) {
+        ini_section->cached_values = ini_allocate_zeroed(ini_file, ini_section->properties_capacity * sizeof(struct Ini_Cached_Value));
+    } else if (cached_capacity != ini_section->properties_capacity) {
+        cached_values = ini_reallocate(ini_file, ini_section->cached_values, ini_section->properties_capacity * sizeof(struct Ini_Cached_Value));
+        if (cached_values == NULL) {
+            ini_section_release_cache(ini_file, ini_section);
+            return;
+        }
+        ini_section->cached_values = cached_values;
+    }
+#else
+    (void)ini_file;
+    (void)ini_section;
+    (void)cached_capacity;
+#endif
+}
+
+static void ini_file_reserve_caches(struct Ini_File *const ini_file) {
+    size_t i;
+    ini_section_reserve_cache(ini_file, &ini_file->global_section, ini_file->global_section.properties_capacity);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        ini_section_reserve_cache(ini_file, &ini_file->sections[i], ini_file->sections[i].properties_capacity);
+    }
+}
+
+void ini_section_clear_cache(struct Ini_Section *const ini_section) {
+    if ((ini_section != NULL) && (ini_section->cached_values != NULL)) {
+        memset(ini_section->cached_values, 0, ini_section->properties_size * sizeof(struct Ini_Cached_Value));
+    }
+}
+
+static void ini_file_clear_caches(struct Ini_File *const ini_file) {
+    size_t i;
+    ini_section_clear_cache(&ini_file->global_section);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        ini_section_clear_cache(&ini_file->sections[i]);
+    }
+}
+
+static void ini_section_free_strings(struct Ini_File *const ini_file, struct Ini_Section *const ini_section) {
     size_t i;
-    free(ini_section->name);
+    free_string(ini_file, ini_section->name, ini_section->name_len);
     for (i = 0; i < ini_section->properties_size; i++) {
-        free(ini_section->properties[i].key);
-        free(ini_section->properties[i].value);
+        free_string(ini_file, ini_section->properties[i].key, ini_section->properties[i].key_len);
+        free_string(ini_file, ini_section->properties[i].value, ini_section->properties[i].value_len);
     }
+}
+
+static void ini_section_free(struct Ini_File *const ini_file, struct Ini_Section *const ini_section) {
+#ifndef USE_CUSTOM_STRING_ALLOCATOR
+    ini_section_free_strings(ini_file, ini_section);
+#else
+    /* The buffers of the strings are released at once */
+    (void)ini_file;
 #endif
-    free(ini_section->properties);  
+    ini_release(ini_file, ini_section->properties);
+    ini_release(ini_file, ini_section->properties_index);
+    ini_section_release_cache(ini_file, ini_section);
 }
 
 void ini_file_free(struct Ini_File *const ini_file) {
+    struct Ini_Allocator allocator;
     size_t i;
     if (ini_file == NULL) {
         return;
     }
+    if (ini_file->interned != NULL) {
+#ifndef USE_CUSTOM_STRING_ALLOCATOR
+        /* The interned strings are owned by the table, not by the properties */
+        for (i = 0; i < ini_file->interned_capacity; i++) {
+            ini_release(ini_file, ini_file->interned[i].str);
+        }
+#endif
+        ini_release(ini_file, ini_file->interned);
+    }
 #ifdef USE_CUSTOM_STRING_ALLOCATOR
-    string_buffer_free(ini_file->strings);
+    if (ini_file->free_strings != NULL) {
+        for (i = STRING_SIZE_CLASSES; i > 0; i--) {
+            ini_release(ini_file, ini_file->free_strings[i - 1].strings);
+        }
+        ini_release(ini_file, ini_file->free_strings);
+    }
 #endif
+    unmap_file(ini_file->source, ini_file->source_size);
     for (i = 0; i < ini_file->sections_size; i++) {
-        ini_section_free(&ini_file->sections[i]);
+        ini_section_free(ini_file, &ini_file->sections[i]);
     }
-    ini_section_free(&ini_file->global_section);
-    free(ini_file->sections);
-    free(ini_file);
+    ini_section_free(ini_file, &ini_file->global_section);
+    ini_release(ini_file, ini_file->sections_index);
+    ini_release(ini_file, ini_file->sections);
+#ifdef USE_CUSTOM_STRING_ALLOCATOR
+    string_buffer_free(ini_file, ini_file->strings);
+#endif
+    /* The allocator is stored in the structure being released */
+    allocator = ini_file->allocator;
+    allocator.release(allocator.context, ini_file);
 }
 
 void ini_section_print_to(const struct Ini_Section *const ini_section, FILE *const sink) {
@@ -123,11 +667,12 @@ void ini_section_print_to(const struct Ini_Section *const ini_section, FILE *con
     if (ini_section == NULL) {
         return;
     }
-    if ((ini_section->name != NULL) && (ini_section->name[0] != '\0')) {
-        fprintf(sink, "[%s]\n", ini_section->name);
+    if ((ini_section->name != NULL) && (ini_section->name_len > 0)) {
+        fprintf(sink, "[%.*s]\n", (int)ini_section->name_len, ini_section->name);
     }
     for (property_index = 0; property_index < ini_section->properties_size; property_index++) {
-        fprintf(sink, "%s = %s\n", ini_section->properties[property_index].key, ini_section->properties[property_index].value);
+        const struct Key_Value_Pair *const property = &ini_section->properties[property_index];
+        fprintf(sink, "%.*s = %.*s\n", (int)property->key_len, property->key, (int)property->value_len, property->value);
     }
 }
 
@@ -138,11 +683,11 @@ void ini_file_print_to(const struct Ini_File *const ini_file, FILE *const sink)
     }
     if (ini_file->global_section.properties_size > 0) {
         ini_section_print_to(&ini_file->global_section, sink);
-        putchar('\n');
+        fputc('\n', sink);
     }
     for (section_index = 0; section_index < ini_file->sections_size; section_index++) {
         ini_section_print_to(&ini_file->sections[section_index], sink);
-        putchar('\n');
+        fputc('\n', sink);
     }
 }
 
@@ -163,6 +708,13 @@ char *ini_file_error_to_string(const Ini_File_Error error) {
         "The requested property is not a valid integer number",
         "The requested property is not a valid unsigned number",
         "The requested property is not a valid floating point number",
+        "The parsing was aborted by the callback",
+        "The compiled image is invalid or was built by another version",
+        "The handle was invalidated by a change of the structure",
+        "The requested property is not a valid boolean",
+        "The requested property is not a valid size",
+        "The requested property is not a valid duration",
+        "The line is longer than the maximum length allowed",
     };
 #ifdef _Static_assert
     _Static_assert((NUMBER_OF_INI_FILE_ERRORS == (sizeof(error_messages)/sizeof(error_messages[0]))),
@@ -180,17 +732,23 @@ void ini_file_info(const struct Ini_File *const ini_file) {
     siz = sizeof(*ini_file) + sizeof(*ini_file->sections) * ini_file->sections_capacity;
     if (ini_file->global_section.properties_size > 0) {
 #ifndef USE_CUSTOM_STRING_ALLOCATOR
-        size_t j;
-        for (j = 0; j < ini_file->global_section.properties_size; j++) {
-            siz += 1 + strlen(ini_file->global_section.properties[j].key);
-            siz += 1 + strlen(ini_file->global_section.properties[j].value);
+        if (!(ini_file->flags & ini_zero_copy)) {
+            size_t j;
+            for (j = 0; j < ini_file->global_section.properties_size; j++) {
+                siz += 1 + ini_file->global_section.properties[j].key_len;
+                siz += 1 + ini_file->global_section.properties[j].value_len;
+            }
+            allocs += 2 * ini_file->global_section.properties_size;
         }
-        allocs += 2 * ini_file->global_section.properties_size;
 #endif
         properties += ini_file->global_section.properties_size;
         siz += sizeof(*ini_file->global_section.properties) * ini_file->global_section.properties_capacity;
         allocs++;
         sections++;
+        if (ini_file->global_section.cached_values != NULL) {
+            siz += sizeof(struct Ini_Cached_Value) * ini_file->global_section.properties_capacity;
+            allocs++;
+        }
     }
     if (ini_file->sections_size > 0) {
         allocs++;
@@ -199,7 +757,7 @@ void ini_file_info(const struct Ini_File *const ini_file) {
     {
         struct String_Buffer *strings = ini_file->strings;
         while (strings != NULL) {
-            siz += sizeof(*strings);
+            siz += sizeof(*strings) + strings->size;
             strings = strings->next;
             allocs++;
         }
@@ -207,19 +765,25 @@ void ini_file_info(const struct Ini_File *const ini_file) {
 #endif
     for (i = 0; i < ini_file->sections_size; i++) {
 #ifndef USE_CUSTOM_STRING_ALLOCATOR
-        size_t j;
-        for (j = 0; j < ini_file->sections[i].properties_size; j++) {
-            siz += 1 + strlen(ini_file->sections[i].properties[j].key);
-            siz += 1 + strlen(ini_file->sections[i].properties[j].value);
+        if (!(ini_file->flags & ini_zero_copy)) {
+            size_t j;
+            for (j = 0; j < ini_file->sections[i].properties_size; j++) {
+                siz += 1 + ini_file->sections[i].properties[j].key_len;
+                siz += 1 + ini_file->sections[i].properties[j].value_len;
+            }
+            siz += 1 + ini_file->sections[i].name_len;
+            allocs += 1 + 2 * ini_file->sections[i].properties_size;
         }
-        siz += 1 + strlen(ini_file->sections[i].name);
-        allocs += 1 + 2 * ini_file->sections[i].properties_size;
 #endif
         properties += ini_file->sections[i].properties_size;
         siz += sizeof(*ini_file->sections[i].properties) * ini_file->sections[i].properties_capacity;
         if (ini_file->sections[i].properties_size > 0) {
             allocs++;
         }
+        if (ini_file->sections[i].cached_values != NULL) {
+            siz += sizeof(struct Ini_Cached_Value) * ini_file->sections[i].properties_capacity;
+            allocs++;
+        }
     }
     printf("Sections:         %lu\n", sections);
     printf("Properties:       %lu\n", properties);
@@ -227,32 +791,137 @@ void ini_file_info(const struct Ini_File *const ini_file) {
     printf("Memory used:      %lu bytes\n", siz);
 }
 
+static void ini_section_stats(const struct Ini_Section *const ini_section, struct Ini_File_Stats *const stats) {
+    stats->properties += ini_section->properties_size;
+    stats->capacity_slack += (ini_section->properties_capacity - ini_section->properties_size) * sizeof(*ini_section->properties);
+    if (ini_section->properties_index != NULL) {
+        stats->capacity_slack += (ini_section->properties_index_capacity - ini_section->properties_size) * sizeof(*ini_section->properties_index);
+    }
+    if ((stats->largest_section == NULL) || (ini_section->properties_size > stats->largest_section_properties)) {
+        stats->largest_section = (ini_section->name != NULL) ? ini_section->name : "";
+        stats->largest_section_len = ini_section->name_len;
+        stats->largest_section_properties = ini_section->properties_size;
+    }
+}
+
+Ini_File_Error ini_file_stats(const struct Ini_File *const ini_file, struct Ini_File_Stats *const stats) {
+    size_t i;
+    if ((ini_file == NULL) || (stats == NULL)) {
+        return ini_invalid_parameters;
+    }
+    memset(stats, 0, sizeof(struct Ini_File_Stats));
+    stats->bytes_read = ini_file->bytes_read;
+    stats->lines = ini_file->lines_read;
+    stats->parse_seconds = ini_file->parse_seconds;
+    stats->allocations = ini_file->allocations;
+    stats->bytes_moved = ini_file->bytes_moved;
+    stats->interned_strings = ini_file->interned_size;
+    stats->interned_bytes_saved = ini_file->interning_saved;
+    stats->sections = ini_file->sections_size;
+    stats->capacity_slack = (ini_file->sections_capacity - ini_file->sections_size) * sizeof(*ini_file->sections);
+    if (ini_file->sections_index != NULL) {
+        stats->capacity_slack += (ini_file->sections_index_capacity - ini_file->sections_size) * sizeof(*ini_file->sections_index);
+    }
+    ini_section_stats(&ini_file->global_section, stats);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        ini_section_stats(&ini_file->sections[i], stats);
+    }
+#ifdef USE_CUSTOM_STRING_ALLOCATOR
+    {
+        const struct String_Buffer *strings;
+        for (strings = ini_file->strings; strings != NULL; strings = strings->next) {
+            stats->arena_size += strings->size;
+        }
+        stats->arena_wasted = ini_file->strings_wasted;
+        for (i = 0; (ini_file->free_strings != NULL) && (i < STRING_SIZE_CLASSES); i++) {
+            stats->arena_wasted += ini_file->free_strings[i].strings_size * string_class_size(i);
+        }
+        if (ini_file->strings != NULL) {
+            stats->arena_used = stats->arena_size - stats->arena_wasted - (ini_file->strings->size - ini_file->string_index);
+        }
+    }
+#endif
+    return ini_no_error;
+}
+
+#ifdef USE_CUSTOM_STRING_ALLOCATOR
+/* Allocates size bytes from the current buffer. When it's full, a new buffer is allocated,
+ * twice as large as the previous one. The strings that would take a good part of it get a
+ * buffer of their own instead, which is inserted after the current buffer, so the space left
+ * in the current buffer can still be used. The first buffers are smaller than that, so they
+ * are enlarged for the strings that don't fit in them. */
+static char *string_buffer_allocate(struct Ini_File *const ini_file, const size_t size) {
+    size_t buffer_size = max_size(ini_file->strings_buffer_size, STRING_ALLOCATOR_FIRST_BUFFER_SIZE);
+    struct String_Buffer *buffer;
+    char *str;
+    if ((ini_file->strings != NULL) && (size <= (ini_file->strings->size - ini_file->string_index))) {
+        str = &string_buffer_data(ini_file->strings)[ini_file->string_index];
+        ini_file->string_index += size;
+        return str;
+    }
+    if (size > (max_size(buffer_size, STRING_ALLOCATOR_BUFFER_SIZE) / 4)) {
+        buffer = ini_allocate(ini_file, sizeof(struct String_Buffer) + size);
+        if (buffer == NULL) {
+            return NULL;
+        }
+        buffer->size = size;
+        if (ini_file->strings != NULL) {
+            buffer->next = ini_file->strings->next;
+            ini_file->strings->next = buffer;
+        } else {
+            buffer->next = NULL;
+            ini_file->strings = buffer;
+            ini_file->string_index = size;
+        }
+        return string_buffer_data(buffer);
+    }
+    while (size > (buffer_size / 4)) {
+        buffer_size *= 2;
+    }
+    buffer = ini_allocate(ini_file, sizeof(struct String_Buffer) + buffer_size);
+    if (buffer == NULL) {
+        return NULL;
+    }
+    buffer->size = buffer_size;
+    if (ini_file->strings != NULL) {
+        string_retire_space(ini_file, &string_buffer_data(ini_file->strings)[ini_file->string_index], ini_file->strings->size - ini_file->string_index);
+    }
+    /* Insert new buffer at the beginning */
+    buffer->next = ini_file->strings;
+    ini_file->strings = buffer;
+    ini_file->string_index = size;
+    ini_file->strings_buffer_size = (2 * buffer_size < STRING_ALLOCATOR_MAX_BUFFER_SIZE) ? (2 * buffer_size) : STRING_ALLOCATOR_MAX_BUFFER_SIZE;
+    return string_buffer_data(buffer);
+}
+#endif
+
 static char *copy_sized_string(struct Ini_File *ini_file, const char *const sized_str, const size_t len) {
     char *str;
 #ifdef USE_CUSTOM_STRING_ALLOCATOR
+    size_t size, size_class;
     if (ini_file == NULL) {
         return NULL;
     }
-    /* Checks if the string fits into the maximum buffer size */
-    if ((len + 1) >= STRING_ALLOCATOR_BUFFER_SIZE) {
+    size_class = string_size_class(len, &size);
+    if (size < len) {
         return NULL;
     }
-    if ((ini_file->strings == NULL) || ((ini_file->string_index + len + 1) > sizeof(ini_file->strings->buffer))) {
-        /* Insert new buffer at the beginning */
-        struct String_Buffer *new_strings = malloc(sizeof(struct String_Buffer));
-        if (new_strings == NULL) {
-            return NULL;
-        }
-        new_strings->next = ini_file->strings;
-        ini_file->strings = new_strings;
-        ini_file->string_index = 0;
+    /* Reuses a released string of the same class, if there is one */
+    if ((ini_file->free_strings != NULL) && (size_class < STRING_SIZE_CLASSES) &&
+        (ini_file->free_strings[size_class].strings_size > 0)) {
+        struct String_Free_List *const free_list = &ini_file->free_strings[size_class];
+        str = free_list->strings[--free_list->strings_size];
+        memcpy(str, sized_str, len);
+        str[len] = '\0';
+        return str;
     }
     /* Allocates the memory to store the string */
-    str = &ini_file->strings->buffer[ini_file->string_index];
-    ini_file->string_index += len + 1;
+    str = string_buffer_allocate(ini_file, size);
+    if (str == NULL) {
+        return NULL;
+    }
 #else
-    (void)ini_file;
-    str = malloc(len + 1);
+    str = ini_allocate(ini_file, len + 1);
     if (str == NULL) {
         return NULL;
     }
@@ -262,442 +931,4491 @@ static char *copy_sized_string(struct Ini_File *ini_file, const char *const size
     return str;
 }
 
-static void advance_white_spaces(char **const str) {
-    while (isspace((unsigned char) **str)) {
-        (*str)++;
+static void interned_put(struct Interned_String *const table, const size_t capacity, const struct Interned_String *const string) {
+    size_t slot = string->hash & (capacity - 1);
+    while (table[slot].str != NULL) {
+        slot = (slot + 1) & (capacity - 1);
     }
+    table[slot] = *string;
 }
 
-static void advance_string_until(char **const str, const char *const chars) {
-    while (strchr(chars, **str) == NULL) {
-        (*str)++;
+/* Expands the table of interned strings, if needed, so it can hold size strings */
+static Ini_File_Error interned_reserve(struct Ini_File *const ini_file, const size_t size) {
+    struct Interned_String *table;
+    size_t i, capacity = INITIAL_INDEX_CAPACITY;
+    if (2 * size <= ini_file->interned_capacity) {
+        return ini_no_error;
+    }
+    while (capacity < 2 * size) {
+        capacity *= 2;
+    }
+    table = ini_allocate_zeroed(ini_file, capacity * sizeof(struct Interned_String));
+    if (table == NULL) {
+        return ini_allocation;
+    }
+    for (i = 0; i < ini_file->interned_capacity; i++) {
+        if (ini_file->interned[i].str != NULL) {
+            interned_put(table, capacity, &ini_file->interned[i]);
+        }
     }
+    ini_release(ini_file, ini_file->interned);
+    ini_file->interned = table;
+    ini_file->interned_capacity = capacity;
+    return ini_no_error;
 }
 
-/* This macro is used to simplify the error handling in the parser.
- * If a callback was provided, the error is reported to the user.
- * If the callback returns an integer different from zero,
- * we end the parsing and return NULL. */
-#define ini_file_parse_handle_error(error) \
+/* Returns the slot in which the string is interned, or the empty slot in which it should be */
+static struct Interned_String *interned_find(const struct Ini_File *const ini_file, const char *const str, const size_t len, const size_t hash) {
+    size_t slot = hash & (ini_file->interned_capacity - 1);
+    while (ini_file->interned[slot].str != NULL) {
+        const struct Interned_String *const string = &ini_file->interned[slot];
+        if ((string->hash == hash) && (string->len == len) && (memcmp(string->str, str, len) == 0)) {
+            break;
+        }
+        slot = (slot + 1) & (ini_file->interned_capacity - 1);
+    }
+    return &ini_file->interned[slot];
+}
+
+/* Returns the copy of the string already interned, or stores a new one */
+static char *intern_sized_string(struct Ini_File *const ini_file, const char *const sized_str, const size_t len) {
+    const size_t hash = hash_sized_string(sized_str, len);
+    struct Interned_String *slot;
+    if (interned_reserve(ini_file, ini_file->interned_size + 1) != ini_no_error) {
+        return NULL;
+    }
+    slot = interned_find(ini_file, sized_str, len, hash);
+    if (slot->str != NULL) {
+        ini_file->interning_saved += len + 1;
+        return slot->str;
+    }
+    slot->str = copy_sized_string(ini_file, sized_str, len);
+    if (slot->str != NULL) {
+        slot->len = len;
+        slot->hash = hash;
+        ini_file->interned_size++;
+    }
+    return slot->str;
+}
+
+/* In the zero-copy mode the strings are just referenced, otherwise they are copied,
+ * once for each distinct string in the interning mode */
+static char *store_sized_string(struct Ini_File *ini_file, const char *const sized_str, const size_t len) {
+    if (ini_file->flags & ini_zero_copy) {
+        return (char *)sized_str;
+    }
+    if (ini_file->flags & ini_intern_strings) {
+        return intern_sized_string(ini_file, sized_str, len);
+    }
+    return copy_sized_string(ini_file, sized_str, len);
+}
+
+/* Interns a string already stored. If there is a copy of it in the table, the string is
+ * released and replaced by the copy. The table must have room for the string. */
+static void intern_stored_string(struct Ini_File *const ini_file, char **const str, const size_t len) {
+    struct Interned_String *slot;
+    size_t hash;
+    if (*str == NULL) {
+        return;
+    }
+    hash = hash_sized_string(*str, len);
+    slot = interned_find(ini_file, *str, len, hash);
+    if (slot->str == NULL) {
+        slot->str = *str;
+        slot->len = len;
+        slot->hash = hash;
+        ini_file->interned_size++;
+    } else if (slot->str != *str) {
+        release_string(ini_file, *str, len);
+        *str = slot->str;
+        ini_file->interning_saved += len + 1;
+    }
+}
+
+Ini_File_Error ini_file_intern_strings(struct Ini_File *const ini_file) {
+    size_t i, j, strings;
+    if ((ini_file == NULL) || (ini_file->flags & ini_zero_copy)) {
+        return ini_invalid_parameters;
+    }
+    if (ini_file->flags & ini_intern_strings) {
+        return ini_no_error;
+    }
+    /* The table is allocated at once, so the strings are never left half interned */
+    strings = ini_file->interned_size + ini_file->sections_size + 2 * ini_file->global_section.properties_size;
+    for (i = 0; i < ini_file->sections_size; i++) {
+        strings += 2 * ini_file->sections[i].properties_size;
+    }
+    if (interned_reserve(ini_file, strings) != ini_no_error) {
+        return ini_allocation;
+    }
+    ini_file->flags |= ini_intern_strings;
+    for (i = 0; i <= ini_file->sections_size; i++) {
+        struct Ini_Section *const section = (i == 0) ? &ini_file->global_section : &ini_file->sections[i - 1];
+        intern_stored_string(ini_file, &section->name, section->name_len);
+        for (j = 0; j < section->properties_size; j++) {
+            intern_stored_string(ini_file, &section->properties[j].key, section->properties[j].key_len);
+            intern_stored_string(ini_file, &section->properties[j].value, section->properties[j].value_len);
+        }
+    }
+    return ini_no_error;
+}
+
+Ini_File_Error ini_file_find_interned(const struct Ini_File *const ini_file, const char *const str, const char **const interned) {
+    const struct Interned_String *slot;
+    size_t len;
+    if ((ini_file == NULL) || (str == NULL) || (interned == NULL) || !(ini_file->flags & ini_intern_strings)) {
+        return ini_invalid_parameters;
+    }
+    if (ini_file->interned == NULL) {
+        return ini_no_such_property;
+    }
+    len = strlen(str);
+    slot = interned_find(ini_file, str, len, hash_sized_string(str, len));
+    if (slot->str == NULL) {
+        return ini_no_such_property;
+    }
+    *interned = slot->str;
+    return ini_no_error;
+}
+
+static Ini_File_Error ini_file_insert_property(struct Ini_File *const ini_file, const char *const key, const size_t key_len, const char *const value, const size_t value_len, const size_t line_number, const size_t value_offset);
+/* Where the lines of the repeated keys found at the end of the bulk load are read from: the
+ * data parsed, if it's still in memory, otherwise the file, if it has a name */
+struct Ini_Line_Source {
+    const char *data;
+    size_t size;
+    const char *filename;
+};
+
+static Ini_File_Error ini_file_finish_bulk_load(struct Ini_File *const ini_file, const struct Ini_Line_Source *const source, const char *const filename, Ini_File_Error_Callback callback, int *const aborted);
+
+/* Classes of characters used by the tokenizer of the parser. Unlike the functions of
+ * ctype.h, this table doesn't depend on the current locale. The null character ends
+ * the sections, keys and values, as the lines used to be null-terminated strings. */
+#define CHAR_SPACE          0x01 /* " \t\n\v\f\r" */
+#define CHAR_COMMENT        0x02 /* "#;" and the end of the line */
+#define CHAR_SECTION_END    0x04 /* "]#;\r\n" */
+#define CHAR_KEY_END        0x08 /* "=#; \t\r\n" */
+#define CHAR_VALUE_END      0x10 /* "#;\r\n" */
+
+static const unsigned char character_classes[256] = {
+    0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x1d, 0x01, 0x01, 0x1d, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x09, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1e, 0x00, 0x08, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+#define is_char_class(c, char_class) (character_classes[(unsigned char)(c)] & (char_class))
+
+static void advance_white_spaces(const char **const str, const char *const end) {
+    while ((*str < end) && is_char_class(**str, CHAR_SPACE)) {
+        (*str)++;
+    }
+}
+
+/* Advances the string until a character of the class is found */
+static void advance_string_until(const char **const str, const char *const end, const unsigned char char_class) {
+#ifdef USE_VECTORIZED_SCANNER
+    /* The characters of each class, except the null character, which belongs to all of them */
+    const char *const chars = (char_class == CHAR_SECTION_END) ? "]#;\r\n" : ((char_class == CHAR_KEY_END) ? "=#; \t\r\n" : "#;\r\n");
+    Scanner_Block targets[8];
+    size_t i, count = 0;
+    targets[count++] = scanner_broadcast('\0');
+    while (chars[count - 1] != '\0') {
+        targets[count] = scanner_broadcast(chars[count - 1]);
+        count++;
+    }
+    while ((size_t)(end - *str) >= SCANNER_BLOCK_SIZE) {
+        const Scanner_Block block = scanner_load(*str);
+        Scanner_Block found = scanner_zero();
+        unsigned int mask;
+        for (i = 0; i < count; i++) {
+            found = scanner_or(found, scanner_equals(block, targets[i]));
+        }
+        mask = scanner_mask(found);
+        if (mask != 0) {
+            *str += __builtin_ctz(mask);
+            return;
+        }
+        *str += SCANNER_BLOCK_SIZE;
+    }
+#endif
+    while ((*str < end) && !is_char_class(**str, char_class)) {
+        (*str)++;
+    }
+}
+
+/* The line passed to the callback must be null-terminated, so it is copied to a local buffer,
+ * or to one allocated by the allocator if it doesn't fit, which happens only for lines longer
+ * than MAX_LINE_SIZE. If this allocation fails, the error is reported as an allocation failure. */
+static int report_line(const struct Ini_Allocator *const allocator, Ini_File_Error_Callback callback, const char *const filename, const size_t line_number, const size_t column, const char *const line, const size_t line_len, const Ini_File_Error error) {
+    char local_copy[MAX_LINE_SIZE];
+    char *line_copy = local_copy;
+    int result;
+    if (line_len >= sizeof(local_copy)) {
+        line_copy = allocator->allocate(allocator->context, line_len + 1);
+        if (line_copy == NULL) {
+            local_copy[0] = '\0';
+            return callback(filename, line_number, column, local_copy, ini_allocation);
+        }
+    }
+    memcpy(line_copy, line, line_len);
+    line_copy[line_len] = '\0';
+    result = callback(filename, line_number, column, line_copy, error);
+    if (line_copy != local_copy) {
+        allocator->release(allocator->context, line_copy);
+    }
+    return result;
+}
+
+static int ini_file_report_error(const struct Ini_Allocator *const allocator, Ini_File_Error_Callback callback, const char *const filename, const struct Ini_Event *const event, const Ini_File_Error error) {
+    if (callback == NULL) {
+        return 0;
+    }
+    return report_line(allocator, callback, filename, event->line_number, event->column, event->line, event->line_len, error);
+}
+
+/* This macro is used to simplify the reporting of events in the tokenizer.
+ * If the handler returns an integer different from zero, we end the parsing. */
+#define ini_emit_event(event_type) \
+    do { \
+        event.type = event_type; \
+        event.column = (size_t)(cursor - line + 1); \
+        if (handler(&event, user_data) != 0) { \
+            return 1; \
+        } \
+    } while (0)
+
+#define ini_emit_error(error_code) \
+    do { \
+        event.error = error_code; \
+        ini_emit_event(ini_event_error); \
+    } while (0)
+
+/* Reports the comment that starts at the cursor, if there is any */
+#define ini_emit_comment() \
     do { \
-        if (callback != NULL) { \
-            if (callback(filename, line_number, (size_t)(cursor - line + 1), line, error) != 0) { \
-                goto ini_file_parse_error; \
+        if ((cursor < line_end) && ((*cursor == '#') || (*cursor == ';'))) { \
+            event.name = cursor + 1; \
+            event.name_len = (size_t)(line_end - event.name); \
+            while ((event.name_len > 0) && is_char_class(event.name[event.name_len - 1], CHAR_SPACE)) { \
+                event.name_len--; \
             } \
+            event.value = NULL; \
+            event.value_len = 0; \
+            ini_emit_event(ini_event_comment); \
         } \
     } while (0)
 
-/* Remember to free the memory allocated for the returned ini file structure */
-struct Ini_File *ini_file_parse(const char *const filename, Ini_File_Error_Callback callback) {
-    Ini_File_Error error;
-    char line[MAX_LINE_SIZE];
+/* Tokenizes a single line of the INI file, delimited by [line, line_end), and reports the
+ * events found to the handler. The line may include the new line character. Returns a
+ * value different from zero if the handler asked to stop the parsing. */
+static int ini_tokenize_line(const char *const line, const char *const line_end, const size_t line_number, const size_t line_offset, Ini_Event_Handler handler, void *const user_data) {
+    struct Ini_Event event;
+    const char *cursor = line;
+    event.line_number = line_number;
+    event.offset = line_offset;
+    event.line = line;
+    event.line_len = (size_t)(line_end - line);
+    event.name = event.value = NULL;
+    event.name_len = event.value_len = 0;
+    event.error = ini_no_error;
+    advance_white_spaces(&cursor, line_end);
+    /* Discards empty lines and reports the commments */
+    if ((cursor == line_end) || is_char_class(*cursor, CHAR_COMMENT)) {
+        ini_emit_comment();
+        return 0;
+    }
+    /* Check if is a new section */
+    if (*cursor == '[') {
+        cursor++;
+        advance_white_spaces(&cursor, line_end);
+        event.name = cursor;
+        advance_string_until(&cursor, line_end, CHAR_SECTION_END);
+        if ((cursor == line_end) || (*cursor != ']')) {
+            ini_emit_error(ini_expected_closing_bracket);
+            return 0;
+        }
+        /* Compute length of the name string and remove trailing whitespaces */
+        event.name_len = (size_t)(cursor - event.name);
+        while ((event.name_len > 0) && is_char_class(event.name[event.name_len - 1], CHAR_SPACE)) {
+            event.name_len--;
+        }
+        if (event.name_len == 0) {
+            ini_emit_error(ini_section_not_provided);
+            return 0;
+        }
+        ini_emit_event(ini_event_section);
+        /* We just ignore the possible characters after the end of the declaration of the section */
+        cursor++;
+        advance_white_spaces(&cursor, line_end);
+        ini_emit_comment();
+        return 0;
+    }
+    event.name = cursor;
+    advance_string_until(&cursor, line_end, CHAR_KEY_END);
+    /* Compute length of the string name */
+    event.name_len = (size_t)(cursor - event.name);
+    if (event.name_len == 0) {
+        ini_emit_error(ini_key_not_provided);
+        return 0;
+    }
+    advance_white_spaces(&cursor, line_end);
+    if ((cursor == line_end) || (*cursor != '=')) {
+        ini_emit_error(ini_expected_equals);
+        return 0;
+    }
+    cursor++;
+    advance_white_spaces(&cursor, line_end);
+    event.value = cursor;
+    advance_string_until(&cursor, line_end, CHAR_VALUE_END);
+    /* Compute length of the value string and remove trailing whitespaces */
+    event.value_len = (size_t)(cursor - event.value);
+    while ((event.value_len > 0) && is_char_class(event.value[event.value_len - 1], CHAR_SPACE)) {
+        event.value_len--;
+    }
+    if (event.value_len == 0) {
+        ini_emit_error(ini_value_not_provided);
+        return 0;
+    }
+    ini_emit_event(ini_event_property);
+    ini_emit_comment();
+    return 0;
+}
+
+/* Tokenizes the lines found in the buffer data, with a size of len bytes, which starts at
+ * the line first_line_number and at the byte first_offset of the input. Returns the number
+ * of lines tokenized, which is smaller than the number of lines of the input if the handler
+ * asked to stop the parsing. */
+static size_t ini_tokenize_lines(const char *const data, const size_t len, const size_t first_line_number, const size_t first_offset, Ini_Event_Handler handler, void *const user_data) {
+    const char *line = data;
+    const char *const end = data + len;
     size_t line_number;
+    for (line_number = first_line_number; line < end; line_number++) {
+        const char *line_end = memchr(line, '\n', (size_t)(end - line));
+        line_end = (line_end == NULL) ? end : (line_end + 1);
+        if (ini_tokenize_line(line, line_end, line_number, first_offset + (size_t)(line - data), handler, user_data) != 0) {
+            return line_number - first_line_number + 1;
+        }
+        line = line_end;
+    }
+    return line_number - first_line_number;
+}
+
+/* Splits the chunks of data in lines, which are tokenized. The complete lines are tokenized
+ * directly from the chunks, and only the unfinished line is kept between the calls. */
+struct Ini_Line_Splitter {
+    Ini_Event_Handler handler;
+    void *user_data;
+    /* Allocator of the unfinished line, which is the one of the structure being built */
+    const struct Ini_Allocator *allocator;
+    /* Unfinished line */
+    char *line;
+    size_t line_size;
+    size_t line_capacity;
+    /* Maximum length of the lines, not counting the new line character, or zero if unlimited */
+    size_t max_line_length;
+    size_t line_number;
+    /* Offset of the line from the beginning of the input */
+    size_t offset;
+    /* Set if the handler asked to stop the parsing */
+    int stopped;
+    /* Set if the unfinished line couldn't be stored or is too long, after which the input is
+     * refused, as the lines would be split in the wrong places */
+    Ini_File_Error error;
+};
+
+static void line_splitter_init(struct Ini_Line_Splitter *const splitter, Ini_Event_Handler handler, void *const user_data, const struct Ini_Allocator *const allocator) {
+    memset(splitter, 0, sizeof(*splitter));
+    splitter->handler = handler;
+    splitter->user_data = user_data;
+    splitter->allocator = allocator;
+    splitter->line_number = 1;
+}
+
+static Ini_File_Error line_splitter_append(struct Ini_Line_Splitter *const splitter, const char *const data, const size_t len) {
+    const size_t line_length = splitter->line_size + len - ((len > 0) && (data[len - 1] == '\n'));
+    if ((splitter->max_line_length > 0) && (line_length > splitter->max_line_length)) {
+        return ini_line_too_long;
+    }
+    if (splitter->line_size + len > splitter->line_capacity) {
+        size_t new_capacity = max_size(splitter->line_capacity, MAX_LINE_SIZE);
+        char *new_line;
+        while (new_capacity < splitter->line_size + len) {
+            new_capacity *= 2;
+        }
+        new_line = splitter->allocator->reallocate(splitter->allocator->context, splitter->line, new_capacity);
+        if (new_line == NULL) {
+            return ini_allocation;
+        }
+        splitter->line = new_line;
+        splitter->line_capacity = new_capacity;
+    }
+    memcpy(&splitter->line[splitter->line_size], data, len);
+    splitter->line_size += len;
+    return ini_no_error;
+}
+
+static Ini_File_Error line_splitter_feed(struct Ini_Line_Splitter *const splitter, const char *data, const size_t len) {
+    const char *const end = data + len;
+    if (splitter->error != ini_no_error) {
+        return splitter->error;
+    }
+    if (splitter->stopped) {
+        return ini_no_error;
+    }
+    if (splitter->line_size > 0) {
+        /* Completes the unfinished line */
+        const char *line_end = memchr(data, '\n', len);
+        line_end = (line_end == NULL) ? end : (line_end + 1);
+        splitter->error = line_splitter_append(splitter, data, (size_t)(line_end - data));
+        if (splitter->error != ini_no_error) {
+            return splitter->error;
+        }
+        if (splitter->line[splitter->line_size - 1] != '\n') {
+            return ini_no_error;
+        }
+        splitter->stopped = ini_tokenize_line(splitter->line, splitter->line + splitter->line_size, splitter->line_number++, splitter->offset, splitter->handler, splitter->user_data);
+        splitter->offset += splitter->line_size;
+        splitter->line_size = 0;
+        data = line_end;
+    }
+    while ((data < end) && !splitter->stopped) {
+        const char *line_end = memchr(data, '\n', (size_t)(end - data));
+        if (line_end == NULL) {
+            splitter->error = line_splitter_append(splitter, data, (size_t)(end - data));
+            return splitter->error;
+        }
+        if ((splitter->max_line_length > 0) && ((size_t)(line_end - data) > splitter->max_line_length)) {
+            splitter->error = ini_line_too_long;
+            return splitter->error;
+        }
+        line_end++;
+        splitter->stopped = ini_tokenize_line(data, line_end, splitter->line_number++, splitter->offset, splitter->handler, splitter->user_data);
+        splitter->offset += (size_t)(line_end - data);
+        data = line_end;
+    }
+    return ini_no_error;
+}
+
+/* Tokenizes the last line, which may not end with a new line character */
+static void line_splitter_finish(struct Ini_Line_Splitter *const splitter) {
+    if ((splitter->line_size > 0) && !splitter->stopped && (splitter->error == ini_no_error)) {
+        splitter->stopped = ini_tokenize_line(splitter->line, splitter->line + splitter->line_size, splitter->line_number++, splitter->offset, splitter->handler, splitter->user_data);
+        splitter->offset += splitter->line_size;
+    }
+    if (splitter->line != NULL) {
+        splitter->allocator->release(splitter->allocator->context, splitter->line);
+    }
+    splitter->line = NULL;
+    splitter->line_size = splitter->line_capacity = 0;
+}
+
+/* Tokenizes the file, which is read in chunks. Only the unfinished line is kept between the
+ * chunks, so the memory used doesn't depend on the size of the file. The buffers are
+ * allocated by the allocator provided. The number of bytes and lines tokenized are stored at
+ * bytes_read and lines_read. */
+static Ini_File_Error ini_tokenize_file(const char *const filename, Ini_Event_Handler handler, void *const user_data, const struct Ini_Allocator *const allocator, size_t *const bytes_read, size_t *const lines_read) {
+    Ini_File_Error error = ini_no_error;
+    struct Ini_Line_Splitter splitter;
+    size_t len;
     FILE *file;
-    struct Ini_File *ini_file = ini_file_new();
-    if (ini_file == NULL) {
+    char *buffer = allocator->allocate(allocator->context, READ_BUFFER_SIZE);
+    if (buffer == NULL) {
+        return ini_allocation;
+    }
+    file = fopen(filename, "rb");
+	if (file == NULL) {
+        allocator->release(allocator->context, buffer);
+        return ini_couldnt_open_file;
+    }
+    line_splitter_init(&splitter, handler, user_data, allocator);
+    while ((error == ini_no_error) && !splitter.stopped && ((len = fread(buffer, sizeof(char), READ_BUFFER_SIZE, file)) > 0)) {
+        error = line_splitter_feed(&splitter, buffer, len);
+    }
+    if (error == ini_no_error) {
+        line_splitter_finish(&splitter);
+    } else if (splitter.line != NULL) {
+        allocator->release(allocator->context, splitter.line);
+    }
+    *bytes_read = splitter.offset;
+    *lines_read = splitter.line_number - 1;
+    allocator->release(allocator->context, buffer);
+    fclose(file);
+    return error;
+}
+
+Ini_File_Error ini_parse_events(const char *const filename, Ini_Event_Handler handler, void *const user_data) {
+    size_t bytes_read, lines_read;
+    if ((filename == NULL) || (handler == NULL)) {
+        return ini_invalid_parameters;
+    }
+    return ini_tokenize_file(filename, handler, user_data, &default_allocator, &bytes_read, &lines_read);
+}
+
+Ini_File_Error ini_parse_events_buffer(const char *const data, const size_t len, Ini_Event_Handler handler, void *const user_data) {
+    if (((data == NULL) && (len > 0)) || (handler == NULL)) {
+        return ini_invalid_parameters;
+    }
+    ini_tokenize_lines(data, len, 1, 0, handler, user_data);
+    return ini_no_error;
+}
+
+/* Errors found by the workers of the parallel parser, which are reported later */
+struct Ini_Error_Record {
+    size_t line_number;
+    size_t column;
+    Ini_File_Error error;
+    char *line;
+};
+
+struct Ini_Error_Log {
+    size_t errors_size;
+    size_t errors_capacity;
+    struct Ini_Error_Record *errors;
+};
+
+static Ini_File_Error ini_error_log_append(struct Ini_Error_Log *const log, const struct Ini_Event *const event, const Ini_File_Error error) {
+    struct Ini_Error_Record *record;
+    const size_t line_len = event->line_len;
+    array_resize(log->errors, INITIAL_PROPERTIES_CAPACITY);
+    record = &log->errors[log->errors_size];
+    record->line = malloc(line_len + 1);
+    if (record->line == NULL) {
+        return ini_allocation;
+    }
+    memcpy(record->line, event->line, line_len);
+    record->line[line_len] = '\0';
+    record->line_number = event->line_number;
+    record->column = event->column;
+    record->error = error;
+    log->errors_size++;
+    return ini_no_error;
+}
+
+static void ini_error_log_free(struct Ini_Error_Log *const log) {
+    size_t i;
+    for (i = 0; i < log->errors_size; i++) {
+        free(log->errors[i].line);
+    }
+    free(log->errors);
+}
+
+/* State used to build the Ini_File structure from the events reported by the tokenizer */
+struct Ini_File_Builder {
+    struct Ini_File *ini_file;
+    const char *filename;
+    Ini_File_Error_Callback callback;
+    /* If provided, the errors are stored in this log instead of being reported to the callback */
+    struct Ini_Error_Log *log;
+    /* Set if the callback asked to stop the parsing, or if the errors couldn't be stored */
+    int aborted;
+};
+
+static int ini_file_handle_event(const struct Ini_Event *const event, void *const user_data) {
+    struct Ini_File_Builder *const builder = user_data;
+    Ini_File_Error error;
+    switch (event->type) {
+    case ini_event_section:
+        error = ini_file_add_section_sized(builder->ini_file, event->name, event->name_len);
+        break;
+    case ini_event_property:
+        error = ini_file_insert_property(builder->ini_file, event->name, event->name_len, event->value, event->value_len, event->line_number,
+            event->offset + (size_t)(event->value - event->line));
+        break;
+    case ini_event_error:
+        error = event->error;
+        break;
+    default:
+        return 0;
+    }
+    if (error == ini_no_error) {
+        return 0;
+    }
+    if (builder->log != NULL) {
+        builder->aborted = (ini_error_log_append(builder->log, event, error) != ini_no_error);
+    } else {
+        builder->aborted = (ini_file_report_error(&builder->ini_file->allocator, builder->callback, builder->filename, event, error) != 0);
+    }
+    /* If the allocator runs out of memory, it's useless to proceed, even if the callback returns 0 */
+    builder->aborted |= (error == ini_allocation);
+    return builder->aborted;
+}
+
+/* In the bulk-load mode, the arrays are sorted at the end of the parsing.
+ * Returns a value different from zero if the parsing should be aborted. */
+static int ini_file_parse_finish(struct Ini_File *const ini_file, const int flags, const struct Ini_Line_Source *const source, const char *const filename, Ini_File_Error_Callback callback) {
+    int aborted = 0;
+    if ((ini_file->flags & ini_bulk_load) &&
+        (ini_file_finish_bulk_load(ini_file, source, filename, callback, &aborted) == ini_allocation)) {
         /* This is a critical error, so we don't proceed, even if the callback returns 0 */
         if (callback != NULL) {
             callback(filename, 0, 0, NULL, ini_allocation);
         }
-        return NULL;
+        return 1;
     }
-    file = fopen(filename, "rb");
-	if (file == NULL) {
+    /* The hash tables are built only at the end of the parsing, so they are not updated
+     * at every insertion. If they can't be allocated, the binary search is used instead. */
+    if (flags & ini_hash_index) {
+        ini_file_build_index(ini_file);
+    }
+    /* The parallel parser interns the strings only after merging the chunks */
+    if ((flags & ini_intern_strings) && !(ini_file->flags & ini_zero_copy)) {
+        ini_file_intern_strings(ini_file);
+    }
+    return aborted;
+}
+
+/* Builds the Ini_File structure from the content of the file already stored in memory
+ * (data) or, if data is NULL, from the file read line by line. */
+static struct Ini_File *ini_file_build(const char *const data, const size_t len, const int flags, const struct Ini_Allocator *const allocator, const char *const filename, Ini_File_Error_Callback callback) {
+    Ini_File_Error error = ini_no_error;
+    struct Ini_File_Builder builder;
+    struct Ini_Line_Source source;
+    source.data = data;
+    source.size = len;
+    source.filename = (data == NULL) ? filename : NULL;
+    builder.ini_file = ini_file_new_with_allocator(allocator);
+    builder.filename = filename;
+    builder.callback = callback;
+    builder.log = NULL;
+    builder.aborted = 0;
+    if (builder.ini_file == NULL) {
         /* This is a critical error, so we don't proceed, even if the callback returns 0 */
         if (callback != NULL) {
-            callback(filename, 0, 0, NULL, ini_couldnt_open_file);
+            callback(filename, 0, 0, NULL, ini_allocation);
         }
-        ini_file_free(ini_file);
         return NULL;
     }
-    for (line_number = 1; fgets(line, sizeof(line), file) != NULL; line_number++) {
-        char *cursor = line;
-        char *key, *value;
-        size_t key_len, value_len;
-        advance_white_spaces(&cursor);
-        /* Discards commments */
-        if (strchr("#;", *cursor) != NULL) {
-            continue;
-        }
-        /* Check if is a new section */
-        if (*cursor == '[') {
-            size_t name_len;
-            char *name;
-            cursor++;
-            advance_white_spaces(&cursor);
-            name = cursor;
-            advance_string_until(&cursor, "]#;\r\n");
-            if (*cursor != ']') {
-                ini_file_parse_handle_error(ini_expected_closing_bracket);
-                continue;
-            }
-            /* Compute length of the name string and remove trailing whitespaces */
-            name_len = (size_t)(cursor - name);
-            while ((name_len > 0) && (isspace((unsigned char)name[name_len - 1]))) {
-                name_len--;
-            }
-            error = ini_file_add_section_sized(ini_file, name, name_len);
-            if (error != ini_no_error) {
-                ini_file_parse_handle_error(error);
-            }
-            /* We just ignore the possible characters after the end of the declaration of the section */
-            continue;
-        }
-        key = cursor;
-        advance_string_until(&cursor, "=#; \t\r\n");
-        /* Compute length of the string name */
-        key_len = (size_t)(cursor - key);
-        if (key_len == 0) {
-            ini_file_parse_handle_error(ini_key_not_provided);
-            continue;
-        }
-        advance_white_spaces(&cursor);
-        if (*cursor != '=') {
-            ini_file_parse_handle_error(ini_expected_equals);
-            continue;
+    /* The hash tables are only built at the end */
+    builder.ini_file->flags = flags & ~ini_hash_index;
+    if (data != NULL) {
+        builder.ini_file->lines_read = ini_tokenize_lines(data, len, 1, 0, ini_file_handle_event, &builder);
+        builder.ini_file->bytes_read = len;
+    } else {
+        error = ini_tokenize_file(filename, ini_file_handle_event, &builder, &builder.ini_file->allocator, &builder.ini_file->bytes_read, &builder.ini_file->lines_read);
+    }
+    if (error != ini_no_error) {
+        /* This is a critical error, so we don't proceed, even if the callback returns 0 */
+        if (callback != NULL) {
+            callback(filename, 0, 0, NULL, error);
         }
-        cursor++;
-        advance_white_spaces(&cursor);
-        value = cursor;
-        advance_string_until(&cursor, "#;\r\n");
-        /* Compute length of the value string and remove trailing whitespaces */
-        value_len = (size_t)(cursor - value);
-        while ((value_len > 0) && (isspace((unsigned char)value[value_len - 1]))) {
-            value_len--;
-        }
-        error = ini_file_add_property_sized(ini_file, key, key_len, value, value_len);
-        if (error != ini_no_error) {
-            ini_file_parse_handle_error(error);
+        ini_file_free(builder.ini_file);
+        return NULL;
+    }
+    if (builder.aborted || (ini_file_parse_finish(builder.ini_file, flags, &source, filename, callback) != 0)) {
+        ini_file_free(builder.ini_file);
+        return NULL;
+    }
+    return builder.ini_file;
+}
+
+static struct Ini_File *ini_file_parse_mapped(const char *const filename, const int flags, const struct Ini_Allocator *const allocator, Ini_File_Error_Callback callback) {
+    char *data;
+    size_t size;
+    struct Ini_File *ini_file;
+    Ini_File_Error error = map_file(filename, &data, &size);
+    if (error != ini_no_error) {
+        /* This is a critical error, so we don't proceed, even if the callback returns 0 */
+        if (callback != NULL) {
+            callback(filename, 0, 0, NULL, error);
         }
+        return NULL;
     }
-    fclose(file);
+    /* Empty files are not mapped, but the strings must not be copied anyway */
+    ini_file = ini_file_build(((data != NULL) ? data : ""), size, (flags | ini_zero_copy), allocator, filename, callback);
+    if (ini_file == NULL) {
+        unmap_file(data, size);
+        return NULL;
+    }
+    ini_file->source = data;
+    ini_file->source_size = size;
     return ini_file;
-ini_file_parse_error:
-    ini_file_free(ini_file);
-    fclose(file);
-    return NULL;
 }
 
-/* This function compares a sized-string str1 with a null-terminated string str2 */
-static int compare_sized_str_to_cstr(const char* str1, const char* str2, size_t len1) {
-    const int comp = strncmp(str1, str2, len1);
-    /* If str1 is equal to the first len characters of str2,
-     * but str2 is longer than len characters, str1 is considered
-     * less than str2 */
-    if ((comp == 0) && (str2[len1] > '\0')) {
-        return -1;
+/* Remember to free the memory allocated for the returned ini file structure */
+struct Ini_File *ini_file_parse_with_allocator(const char *const filename, const int flags, const struct Ini_Allocator *const allocator, Ini_File_Error_Callback callback) {
+    const double start = current_seconds();
+    struct Ini_File *ini_file;
+    if (flags & ini_memory_map) {
+        ini_file = ini_file_parse_mapped(filename, flags, allocator, callback);
+    } else {
+        /* The lines are read to a temporary buffer, so the strings must be copied */
+        ini_file = ini_file_build(NULL, 0, (flags & ~ini_zero_copy), allocator, filename, callback);
+    }
+    if (ini_file != NULL) {
+        ini_file->parse_seconds = current_seconds() - start;
     }
-    return comp;
+    return ini_file;
 }
 
-/* Binary search algorithm */
-#define binary_search(array, elem, str, len) \
-    do { \
-        size_t low = 0; \
-        size_t high = array ## _size - 1; \
-        while ((low <= high) && (high < array ## _size)) { \
-            int comp; \
-            *index = (low + high) / 2; \
-            comp = compare_sized_str_to_cstr(str, array[*index].elem, len); \
-            if (comp < 0) { \
-                high = *index - 1; \
-            } else if (comp > 0) { \
-                low = *index + 1; \
-            } else { \
-                return ini_no_error; \
-            } \
-        } \
-        /* Didn't found the requested element, so return the correct index \
-         * to insert the new element, keeping the order of the array */ \
-        *index = low; \
-    } while (0)
-
-static Ini_File_Error ini_file_find_section_index(struct Ini_File *const ini_file, const char *const section, const size_t section_len, size_t *const index) {
-    binary_search(ini_file->sections, name, section, section_len);
-    return ini_no_such_section;
+/* Remember to free the memory allocated for the returned ini file structure */
+struct Ini_File *ini_file_parse_with_flags(const char *const filename, const int flags, Ini_File_Error_Callback callback) {
+    return ini_file_parse_with_allocator(filename, flags, NULL, callback);
 }
 
-static Ini_File_Error ini_file_find_key_index(struct Ini_Section *const ini_section, const char *const key, const size_t key_len, size_t *const index) {
-    binary_search(ini_section->properties, key, key, key_len);
-    return ini_no_such_property;
+/* Remember to free the memory allocated for the returned ini file structure */
+struct Ini_File *ini_file_parse(const char *const filename, Ini_File_Error_Callback callback) {
+    return ini_file_parse_with_flags(filename, ini_default_flags, callback);
 }
 
-Ini_File_Error ini_file_find_section(struct Ini_File *const ini_file, const char *const section, Ini_Section **const ini_section) {
-    Ini_File_Error  error;
-    size_t section_index;
-    if ((ini_file == NULL) || (ini_section == NULL)) {
-        return ini_invalid_parameters;
+/* Remember to free the memory allocated for the returned ini file structure */
+struct Ini_File *ini_file_parse_buffer_with_allocator(const char *const data, const size_t len, const int flags, const struct Ini_Allocator *const allocator, Ini_File_Error_Callback callback) {
+    /* Name reported to the callback, as there is no file associated to the buffer */
+    static const char *const filename = "<buffer>";
+    const double start = current_seconds();
+    struct Ini_File *ini_file;
+    if ((data == NULL) && (len > 0)) {
+        if (callback != NULL) {
+            callback(filename, 0, 0, NULL, ini_invalid_parameters);
+        }
+        return NULL;
     }
-    if ((section == NULL) || (section[0] == '\0')) {
-        *ini_section = &ini_file->global_section;
-        return ini_no_error;
+    /* The flag ini_memory_map doesn't make sense for buffers */
+    ini_file = ini_file_build(((data != NULL) ? data : ""), len, (flags & ~ini_memory_map), allocator, filename, callback);
+    if (ini_file != NULL) {
+        ini_file->parse_seconds = current_seconds() - start;
     }
-    error = ini_file_find_section_index(ini_file, section, strlen(section), &section_index);
-    if (error == ini_no_error) {
-        *ini_section = &ini_file->sections[section_index];
+    return ini_file;
+}
+
+/* Remember to free the memory allocated for the returned ini file structure */
+struct Ini_File *ini_file_parse_buffer(const char *const data, const size_t len, const int flags, Ini_File_Error_Callback callback) {
+    return ini_file_parse_buffer_with_allocator(data, len, flags, NULL, callback);
+}
+
+struct Ini_Parser {
+    struct Ini_Line_Splitter splitter;
+    struct Ini_File_Builder builder;
+    int flags;
+};
+
+/* The parser itself and its unfinished line are also allocated by the allocator */
+Ini_Parser *ini_parser_new_with_allocator(const int flags, const struct Ini_Allocator *const allocator, Ini_File_Error_Callback callback) {
+    struct Ini_File *const ini_file = ini_file_new_with_allocator(allocator);
+    struct Ini_Parser *parser;
+    if (ini_file == NULL) {
+        return NULL;
+    }
+    parser = ini_file->allocator.allocate(ini_file->allocator.context, sizeof(struct Ini_Parser));
+    if (parser == NULL) {
+        ini_file_free(ini_file);
+        return NULL;
+    }
+    parser->builder.ini_file = ini_file;
+    /* The chunks are not kept, so the strings must be copied. The hash tables are only built at the end */
+    parser->flags = flags & ~(ini_zero_copy | ini_memory_map);
+    parser->builder.ini_file->flags = parser->flags & ~ini_hash_index;
+    /* Name reported to the callback, as there is no file associated to the stream */
+    parser->builder.filename = "<stream>";
+    parser->builder.callback = callback;
+    parser->builder.log = NULL;
+    parser->builder.aborted = 0;
+    line_splitter_init(&parser->splitter, ini_file_handle_event, &parser->builder, &ini_file->allocator);
+    parser->splitter.max_line_length = INI_PARSER_MAX_LINE_LENGTH;
+    return parser;
+}
+
+Ini_Parser *ini_parser_new(const int flags, Ini_File_Error_Callback callback) {
+    return ini_parser_new_with_allocator(flags, NULL, callback);
+}
+
+Ini_File_Error ini_parser_set_max_line_length(struct Ini_Parser *const parser, const size_t max_line_length) {
+    if (parser == NULL) {
+        return ini_invalid_parameters;
+    }
+    parser->splitter.max_line_length = max_line_length;
+    return ini_no_error;
+}
+
+Ini_File_Error ini_parser_feed(struct Ini_Parser *const parser, const char *const data, const size_t len) {
+    double start;
+    Ini_File_Error error;
+    if ((parser == NULL) || ((data == NULL) && (len > 0))) {
+        return ini_invalid_parameters;
+    }
+    /* Only the time spent inside the parser is accounted */
+    start = current_seconds();
+    error = line_splitter_feed(&parser->splitter, data, len);
+    parser->builder.ini_file->parse_seconds += current_seconds() - start;
+    if (error != ini_no_error) {
+        return error;
+    }
+    return parser->builder.aborted ? ini_parsing_aborted : ini_no_error;
+}
+
+struct Ini_File *ini_parser_finish(struct Ini_Parser *const parser) {
+    /* The lines already parsed aren't kept */
+    static const struct Ini_Line_Source source = {NULL, 0, NULL};
+    struct Ini_Allocator allocator;
+    struct Ini_File *ini_file;
+    double start;
+    if (parser == NULL) {
+        return NULL;
+    }
+    start = current_seconds();
+    line_splitter_finish(&parser->splitter);
+    /* The structure may be released before the parser */
+    allocator = parser->builder.ini_file->allocator;
+    ini_file = parser->builder.ini_file;
+    ini_file->bytes_read = parser->splitter.offset;
+    ini_file->lines_read = parser->splitter.line_number - 1;
+    if (parser->splitter.error != ini_no_error) {
+        /* This is a critical error, so we don't proceed, even if the callback returns 0 */
+        if (parser->builder.callback != NULL) {
+            parser->builder.callback(parser->builder.filename, parser->splitter.line_number, 0, NULL, parser->splitter.error);
+        }
+        ini_file_free(ini_file);
+        ini_file = NULL;
+    } else if (parser->builder.aborted || (ini_file_parse_finish(ini_file, parser->flags, &source, parser->builder.filename, parser->builder.callback) != 0)) {
+        ini_file_free(ini_file);
+        ini_file = NULL;
+    } else {
+        ini_file->parse_seconds += current_seconds() - start;
+    }
+    allocator.release(allocator.context, parser);
+    return ini_file;
+}
+
+/* This function compares two sized-strings */
+static int compare_sized_strings(const char *const str1, const size_t len1, const char *const str2, const size_t len2) {
+    const int comp = memcmp(str1, str2, ((len1 < len2) ? len1 : len2));
+    if (comp != 0) {
+        return comp;
+    }
+    /* If str1 is equal to the first characters of str2,
+     * but str2 is longer, str1 is considered less than str2 */
+    if (len1 < len2) {
+        return -1;
+    }
+    return (len1 > len2);
+}
+
+/* Binary search algorithm */
+#define binary_search(array, elem, str, len) \
+    do { \
+        size_t low = 0; \
+        size_t high = array ## _size - 1; \
+        while ((low <= high) && (high < array ## _size)) { \
+            int comp; \
+            *index = (low + high) / 2; \
+            comp = compare_sized_strings(str, len, array[*index].elem, array[*index].elem ## _len); \
+            if (comp < 0) { \
+                high = *index - 1; \
+            } else if (comp > 0) { \
+                low = *index + 1; \
+            } else { \
+                return ini_no_error; \
+            } \
+        } \
+        /* Didn't found the requested element, so return the correct index \
+         * to insert the new element, keeping the order of the array */ \
+        *index = low; \
+    } while (0)
+
+/* Returns the position of the first element of the sorted array, from the position first,
+ * that isn't smaller than the string. If prefix isn't zero, returns the position of the first element that doesn't start
+ * with the string and is greater than it, which ends the elements starting with it. */
+#define lower_bound_function(function_name, type, elem) \
+    static size_t function_name(const type *const array, const size_t first, const size_t size, const char *const str, const size_t len, const int prefix) { \
+        size_t low = first, high = size; \
+        while (low < high) { \
+            const size_t middle = low + (high - low) / 2; \
+            const size_t elem_len = (prefix && (array[middle].elem ## _len > len)) ? len : array[middle].elem ## _len; \
+            const int comp = compare_sized_strings(array[middle].elem, elem_len, str, len); \
+            if ((comp < 0) || (prefix && (comp == 0))) { \
+                low = middle + 1; \
+            } else { \
+                high = middle; \
+            } \
+        } \
+        return low; \
+    }
+
+lower_bound_function(section_lower_bound, struct Ini_Section, name)
+lower_bound_function(property_lower_bound, struct Key_Value_Pair, key)
+
+static Ini_File_Error ini_file_find_section_index(struct Ini_File *const ini_file, const char *const section, const size_t section_len, size_t *const index) {
+    binary_search(ini_file->sections, name, section, section_len);
+    return ini_no_such_section;
+}
+
+static Ini_File_Error ini_file_find_key_index(struct Ini_Section *const ini_section, const char *const key, const size_t key_len, size_t *const index) {
+    binary_search(ini_section->properties, key, key, key_len);
+    return ini_no_such_property;
+}
+
+/* The hash tables use open addressing with linear probing. They store the position of the
+ * elements in the sorted arrays plus one, so zero marks an empty slot. The capacity is a
+ * power of two, and it's kept at least twice the number of elements. */
+#define hash_index_functions(prefix, type, elem) \
+    static int prefix ## _index_find(const size_t *const table, const size_t capacity, const type *const array, const char *const str, const size_t len, size_t *const index) { \
+        size_t slot = hash_sized_string(str, len) & (capacity - 1); \
+        while (table[slot] != 0) { \
+            const type *const element = &array[table[slot] - 1]; \
+            if ((element->elem ## _len == len) && (memcmp(element->elem, str, len) == 0)) { \
+                *index = table[slot] - 1; \
+                return 1; \
+            } \
+            slot = (slot + 1) & (capacity - 1); \
+        } \
+        return 0; \
+    } \
+    static void prefix ## _index_put(size_t *const table, const size_t capacity, const type *const array, const size_t index) { \
+        size_t slot = hash_sized_string(array[index].elem, array[index].elem ## _len) & (capacity - 1); \
+        while (table[slot] != 0) { \
+            slot = (slot + 1) & (capacity - 1); \
+        } \
+        table[slot] = index + 1; \
+    } \
+    static Ini_File_Error prefix ## _index_build(struct Ini_File *const ini_file, size_t **const table, size_t *const capacity, const type *const array, const size_t size) { \
+        size_t i, new_capacity = INITIAL_INDEX_CAPACITY; \
+        size_t *new_table; \
+        while (new_capacity < 2 * size) { \
+            new_capacity *= 2; \
+        } \
+        new_table = ini_allocate_zeroed(ini_file, new_capacity * sizeof(size_t)); \
+        if (new_table == NULL) { \
+            return ini_allocation; \
+        } \
+        for (i = 0; i < size; i++) { \
+            prefix ## _index_put(new_table, new_capacity, array, i); \
+        } \
+        ini_release(ini_file, *table); \
+        *table = new_table; \
+        *capacity = new_capacity; \
+        return ini_no_error; \
+    } \
+    /* Updates the hash table after an element was inserted at the given position of the \
+     * sorted array. If it can't be expanded, the table is discarded. */ \
+    static void prefix ## _index_insert(struct Ini_File *const ini_file, size_t **const table, size_t *const capacity, const type *const array, const size_t size, const size_t position) { \
+        size_t i, slot; \
+        if ((*table == NULL) || (2 * size > *capacity)) { \
+            if (prefix ## _index_build(ini_file, table, capacity, array, size) != ini_no_error) { \
+                ini_release(ini_file, *table); \
+                *table = NULL; \
+            } \
+            return; \
+        } \
+        /* The elements after the inserted one were moved by one position. They are updated \
+         * from the last one, so the old position searched is never found twice. */ \
+        for (i = size - 1; i > position; i--) { \
+            slot = hash_sized_string(array[i].elem, array[i].elem ## _len) & (*capacity - 1); \
+            while ((*table)[slot] != i) { \
+                slot = (slot + 1) & (*capacity - 1); \
+            } \
+            (*table)[slot] = i + 1; \
+        } \
+        prefix ## _index_put(*table, *capacity, array, position); \
+    } \
+    /* Updates the hash table after an element was removed from the sorted array. The removal \
+     * would break the sequences of probes, so the table is rebuilt. */ \
+    static void prefix ## _index_remove(struct Ini_File *const ini_file, size_t **const table, size_t *const capacity, const type *const array, const size_t size) { \
+        if ((*table != NULL) && (prefix ## _index_build(ini_file, table, capacity, array, size) != ini_no_error)) { \
+            ini_release(ini_file, *table); \
+            *table = NULL; \
+        } \
+    }
+
+hash_index_functions(section, struct Ini_Section, name)
+hash_index_functions(property, struct Key_Value_Pair, key)
+
+/* These functions use the hash tables if they are available, otherwise the binary search */
+static Ini_File_Error ini_file_lookup_section(struct Ini_File *const ini_file, const char *const section, const size_t section_len, size_t *const index) {
+    if (ini_file->sections_index != NULL) {
+        return section_index_find(ini_file->sections_index, ini_file->sections_index_capacity, ini_file->sections, section, section_len, index) ? ini_no_error : ini_no_such_section;
+    }
+    return ini_file_find_section_index(ini_file, section, section_len, index);
+}
+
+static Ini_File_Error ini_section_lookup_key(struct Ini_Section *const ini_section, const char *const key, const size_t key_len, size_t *const index) {
+    if (ini_section->properties_index != NULL) {
+        return property_index_find(ini_section->properties_index, ini_section->properties_index_capacity, ini_section->properties, key, key_len, index) ? ini_no_error : ini_no_such_property;
+    }
+    return ini_file_find_key_index(ini_section, key, key_len, index);
+}
+
+static void ini_file_free_index(struct Ini_File *const ini_file) {
+    size_t i;
+    ini_release(ini_file, ini_file->sections_index);
+    ini_file->sections_index = NULL;
+    ini_release(ini_file, ini_file->global_section.properties_index);
+    ini_file->global_section.properties_index = NULL;
+    for (i = 0; i < ini_file->sections_size; i++) {
+        ini_release(ini_file, ini_file->sections[i].properties_index);
+        ini_file->sections[i].properties_index = NULL;
+    }
+}
+
+Ini_File_Error ini_file_build_index(struct Ini_File *const ini_file) {
+    Ini_File_Error error;
+    size_t i;
+    if (ini_file == NULL) {
+        return ini_invalid_parameters;
+    }
+    error = section_index_build(ini_file, &ini_file->sections_index, &ini_file->sections_index_capacity, ini_file->sections, ini_file->sections_size);
+    if (error == ini_no_error) {
+        error = property_index_build(ini_file, &ini_file->global_section.properties_index, &ini_file->global_section.properties_index_capacity, ini_file->global_section.properties, ini_file->global_section.properties_size);
+    }
+    for (i = 0; (i < ini_file->sections_size) && (error == ini_no_error); i++) {
+        struct Ini_Section *const section = &ini_file->sections[i];
+        error = property_index_build(ini_file, &section->properties_index, &section->properties_index_capacity, section->properties, section->properties_size);
+    }
+    if (error != ini_no_error) {
+        ini_file_free_index(ini_file);
+        ini_file->flags &= ~ini_hash_index;
+        return error;
+    }
+    ini_file->flags |= ini_hash_index;
+    return ini_no_error;
+}
+
+Ini_File_Error ini_file_find_section(struct Ini_File *const ini_file, const char *const section, Ini_Section **const ini_section) {
+    Ini_File_Error  error;
+    size_t section_index;
+    if ((ini_file == NULL) || (ini_section == NULL)) {
+        return ini_invalid_parameters;
+    }
+    if ((section == NULL) || (section[0] == '\0')) {
+        *ini_section = &ini_file->global_section;
+        return ini_no_error;
+    }
+    error = ini_file_lookup_section(ini_file, section, strlen(section), &section_index);
+    if (error == ini_no_error) {
+        *ini_section = &ini_file->sections[section_index];
+    }
+    return error;
+}
+
+Ini_File_Error ini_section_find_pair(struct Ini_Section *const ini_section, const char *const key, Key_Value_Pair **const property)  {
+    Ini_File_Error error;
+    size_t property_index;
+    if ((ini_section == NULL) || (key == NULL) || (property == NULL)) {
+        return ini_invalid_parameters;
+    }
+    if (key[0] == '\0') {
+        return ini_invalid_parameters;
+    }
+    error = ini_section_lookup_key(ini_section, key, strlen(key), &property_index);
+    if (error == ini_no_error) {
+        *property = &ini_section->properties[property_index];
+    }
+    return error;
+}
+
+Ini_File_Error ini_file_find_pair(struct Ini_File *const ini_file, const char *const section, const char *const key, Key_Value_Pair **const property) {
+    Ini_File_Error error;
+    struct Ini_Section *ini_section;
+    if ((ini_file == NULL) || (key == NULL) || (property == NULL)) {
+        return ini_invalid_parameters;
+    }
+    if (key[0] == '\0') {
+        return ini_invalid_parameters;
+    }
+    error = ini_file_find_section(ini_file, section, &ini_section);
+    if (error != ini_no_error) {
+        return error;
+    }
+    return ini_section_find_pair(ini_section, key, property);
+}
+
+Ini_File_Error ini_section_find_property(struct Ini_Section *const ini_section, const char *const key, char **const value)  {
+    Ini_File_Error error;
+    struct Key_Value_Pair *property;
+    if (value == NULL) {
+        return ini_invalid_parameters;
+    }
+    error = ini_section_find_pair(ini_section, key, &property);
+    if (error == ini_no_error) {
+        *value = property->value;
+    }
+    return error;
+}
+
+Ini_File_Error ini_file_find_property(struct Ini_File *const ini_file, const char *const section, const char *const key, char **const value) {
+    Ini_File_Error error;
+    struct Key_Value_Pair *property;
+    if (value == NULL) {
+        return ini_invalid_parameters;
+    }
+    error = ini_file_find_pair(ini_file, section, key, &property);
+    if (error == ini_no_error) {
+        *value = property->value;
+    }
+    return error;
+}
+
+/* The conversions of the values don't use the functions of the C library, which depend on
+ * the locale and require null-terminated strings. The numbers are parsed directly from the
+ * sized strings, so the values of the zero-copy mode don't need to be copied. */
+
+/* The mantissas smaller than this are accumulated exactly in a double ((2^53 - 9) / 10) */
+#define MAX_EXACT_MANTISSA 900719925474098.0
+
+/* Significant digits kept by the slow path of ini_convert_double. No double is halfway
+ * between two others with more than 767 significant digits, so the digits after these only
+ * matter if they aren't all zeros, which is recorded. */
+#define DECIMAL_MAX_DIGITS 800
+
+/* The larger exponents are clamped, as they already overflow or underflow */
+#define DECIMAL_MAX_EXPONENT 100000L
+
+/* Largest shift of the decimal numbers by powers of two at once, which keeps the digits being
+ * shifted in an unsigned long, even if it has only 32 bits */
+#define DECIMAL_MAX_SHIFT 28
+
+static char ascii_lower(const char c) {
+    return ((c >= 'A') && (c <= 'Z')) ? (char)(c - 'A' + 'a') : c;
+}
+
+static int ascii_equals_ignoring_case(const char *const str, const size_t len, const char *const lower) {
+    size_t i;
+    for (i = 0; i < len; i++) {
+        if ((lower[i] == '\0') || (ascii_lower(str[i]) != lower[i])) {
+            return 0;
+        }
+    }
+    return (lower[len] == '\0');
+}
+
+/* Returns the value of the digit, or base if the character isn't a digit of the base */
+static unsigned int digit_value(const char c, const unsigned int base) {
+    unsigned int digit = base;
+    if ((c >= '0') && (c <= '9')) {
+        digit = (unsigned int)(c - '0');
+    } else if ((c >= 'a') && (c <= 'z')) {
+        digit = (unsigned int)(c - 'a') + 10;
+    } else if ((c >= 'A') && (c <= 'Z')) {
+        digit = (unsigned int)(c - 'A') + 10;
+    }
+    return (digit < base) ? digit : base;
+}
+
+/* Parses the digits of an unsigned number, which may start with the prefix of its base
+ * (0x, 0o or 0b) if prefixes isn't zero. The position of the first character after the
+ * digits is stored at end. Returns zero if there are no digits or if the number doesn't fit
+ * in an unsigned long. */
+static int parse_unsigned_digits(const char *str, const char *const str_end, const int prefixes, unsigned long *const number, const char **const end) {
+    const char *const start = str;
+    unsigned long value = 0;
+    unsigned int base = 10, digit;
+    if (prefixes && ((str_end - str) > 2) && (str[0] == '0')) {
+        const char prefix = ascii_lower(str[1]);
+        base = (prefix == 'x') ? 16 : ((prefix == 'o') ? 8 : ((prefix == 'b') ? 2 : 10));
+        if ((base != 10) && (digit_value(str[2], base) < base)) {
+            str += 2;
+        } else {
+            base = 10;
+        }
+    }
+    for (; (str < str_end) && ((digit = digit_value(*str, base)) < base); str++) {
+        if (value > (ULONG_MAX - digit) / base) {
+            return 0;
+        }
+        value = value * base + digit;
+    }
+    if (str == start) {
+        return 0;
+    }
+    *number = value;
+    *end = str;
+    return 1;
+}
+
+Ini_File_Error ini_convert_integer(const char *const value, const size_t value_len, long *const integer) {
+    const char *str = value, *end;
+    unsigned long magnitude;
+    int negative = 0;
+    if ((value == NULL) || (integer == NULL)) {
+        return ini_invalid_parameters;
+    }
+    if ((value_len > 0) && ((*str == '-') || (*str == '+'))) {
+        negative = (*str++ == '-');
+    }
+    if (!parse_unsigned_digits(str, value + value_len, 1, &magnitude, &end) || (end != value + value_len)) {
+        return ini_not_integer;
+    }
+    if (magnitude > (unsigned long)LONG_MAX + (unsigned long)negative) {
+        return ini_not_integer;
+    }
+    /* The magnitude of LONG_MIN isn't representable as a positive long */
+    *integer = negative ? ((magnitude == 0) ? 0 : (-(long)(magnitude - 1) - 1)) : (long)magnitude;
+    return ini_no_error;
+}
+
+Ini_File_Error ini_convert_unsigned(const char *const value, const size_t value_len, unsigned long *const uint) {
+    const char *str = value, *end;
+    if ((value == NULL) || (uint == NULL)) {
+        return ini_invalid_parameters;
+    }
+    if ((value_len > 0) && (*str == '+')) {
+        str++;
+    }
+    if (!parse_unsigned_digits(str, value + value_len, 1, uint, &end) || (end != value + value_len)) {
+        return ini_not_unsigned;
+    }
+    return ini_no_error;
+}
+
+/* Decimal number 0.d[0]d[1]...d[digits-1] * 10^point, used by the slow path of
+ * ini_convert_double. The digits are values from 0 to 9, without zeros at the end, and
+ * truncated is set if digits different from zero were discarded after them. The number
+ * is converted by multiplying and dividing it by powers of two, which is exact in decimal,
+ * until it's in the range of the mantissa. So the result is always correctly rounded, and
+ * no function of the C library (which would depend on the locale) is used. */
+struct Ini_Decimal {
+    unsigned char d[DECIMAL_MAX_DIGITS];
+    size_t digits;
+    long point;
+    int truncated;
+};
+
+static void decimal_trim(struct Ini_Decimal *const decimal) {
+    while ((decimal->digits > 0) && (decimal->d[decimal->digits - 1] == 0)) {
+        decimal->digits--;
+    }
+    if (decimal->digits == 0) {
+        decimal->point = 0;
+    }
+}
+
+/* Stores the digits of the number, which were already validated by ini_convert_double. The
+ * leading zeros only change the position of the decimal point. */
+static void decimal_parse(struct Ini_Decimal *const decimal, const char *str, const char *const end, const long exponent) {
+    int seen_point = 0;
+    decimal->digits = 0;
+    decimal->point = 0;
+    decimal->truncated = 0;
+    for (; str < end; str++) {
+        if (*str == '.') {
+            seen_point = 1;
+        } else if ((*str == '0') && (decimal->digits == 0) && !decimal->truncated) {
+            if (seen_point && (decimal->point > -DECIMAL_MAX_EXPONENT)) {
+                decimal->point--;
+            }
+        } else {
+            if (decimal->digits < DECIMAL_MAX_DIGITS) {
+                decimal->d[decimal->digits++] = (unsigned char)(*str - '0');
+            } else {
+                decimal->truncated |= (*str != '0');
+            }
+            if (!seen_point && (decimal->point < DECIMAL_MAX_EXPONENT)) {
+                decimal->point++;
+            }
+        }
+    }
+    decimal->point += exponent;
+    decimal_trim(decimal);
+}
+
+/* Multiplies the number by 2^shift. The digits are shifted from the last one, and a shift of
+ * DECIMAL_MAX_SHIFT bits adds at most 9 digits. */
+static void decimal_shift_left(struct Ini_Decimal *const decimal, const unsigned int shift) {
+    unsigned char shifted[DECIMAL_MAX_DIGITS + 9];
+    size_t read = decimal->digits, write = decimal->digits + 9, digits, i;
+    unsigned long carry = 0;
+    while (read > 0) {
+        carry += (unsigned long)decimal->d[--read] << shift;
+        shifted[--write] = (unsigned char)(carry % 10);
+        carry /= 10;
+    }
+    while (carry > 0) {
+        shifted[--write] = (unsigned char)(carry % 10);
+        carry /= 10;
+    }
+    digits = decimal->digits + 9 - write;
+    decimal->point += (long)(digits - decimal->digits);
+    if (digits > DECIMAL_MAX_DIGITS) {
+        for (i = DECIMAL_MAX_DIGITS; i < digits; i++) {
+            decimal->truncated |= (shifted[write + i] != 0);
+        }
+        digits = DECIMAL_MAX_DIGITS;
+    }
+    memcpy(decimal->d, &shifted[write], digits);
+    decimal->digits = digits;
+    decimal_trim(decimal);
+}
+
+/* Divides the number by 2^shift. The digits are divided from the first one, and the ones
+ * written are never ahead of the ones read. */
+static void decimal_shift_right(struct Ini_Decimal *const decimal, const unsigned int shift) {
+    const unsigned long mask = (1UL << shift) - 1;
+    size_t read = 0, write = 0;
+    unsigned long remainder = 0;
+    /* Skips the digits that become zeros at the beginning */
+    while ((remainder >> shift) == 0) {
+        if (read >= decimal->digits) {
+            while ((remainder >> shift) == 0) {
+                remainder *= 10;
+                read++;
+            }
+            break;
+        }
+        remainder = remainder * 10 + decimal->d[read++];
+    }
+    decimal->point -= (long)read - 1;
+    for (; read < decimal->digits; read++) {
+        decimal->d[write++] = (unsigned char)(remainder >> shift);
+        remainder = (remainder & mask) * 10 + decimal->d[read];
+    }
+    while (remainder > 0) {
+        if (write < DECIMAL_MAX_DIGITS) {
+            decimal->d[write++] = (unsigned char)(remainder >> shift);
+        } else {
+            decimal->truncated |= ((remainder >> shift) != 0);
+        }
+        remainder = (remainder & mask) * 10;
+    }
+    decimal->digits = write;
+    decimal_trim(decimal);
+}
+
+/* Multiplies the number by 2^shift, where shift may be negative */
+static void decimal_shift(struct Ini_Decimal *const decimal, int shift) {
+    if (decimal->digits == 0) {
+        return;
+    }
+    for (; shift > DECIMAL_MAX_SHIFT; shift -= DECIMAL_MAX_SHIFT) {
+        decimal_shift_left(decimal, DECIMAL_MAX_SHIFT);
+    }
+    for (; shift < -DECIMAL_MAX_SHIFT; shift += DECIMAL_MAX_SHIFT) {
+        decimal_shift_right(decimal, DECIMAL_MAX_SHIFT);
+    }
+    if (shift > 0) {
+        decimal_shift_left(decimal, (unsigned int)shift);
+    } else if (shift < 0) {
+        decimal_shift_right(decimal, (unsigned int)-shift);
+    }
+}
+
+/* Returns the integer part of the number rounded to the nearest integer, and to the even one
+ * in the ties. It's used when the number is at most 2^53, so it's exact in a double. */
+static double decimal_rounded_integer(const struct Ini_Decimal *const decimal) {
+    double integer = 0.0;
+    size_t i, next;
+    int round_up = 0;
+    for (i = 0; (long)i < decimal->point; i++) {
+        integer = integer * 10.0 + ((i < decimal->digits) ? (double)decimal->d[i] : 0.0);
+    }
+    next = (size_t)decimal->point;
+    if ((decimal->point >= 0) && (next < decimal->digits)) {
+        if ((decimal->d[next] == 5) && (next + 1 == decimal->digits)) {
+            /* Exactly halfway, unless digits were discarded */
+            round_up = decimal->truncated || ((next > 0) && (decimal->d[next - 1] % 2 == 1));
+        } else {
+            round_up = (decimal->d[next] >= 5);
+        }
+    }
+    return round_up ? (integer + 1.0) : integer;
+}
+
+/* Multiplies the value by 2^exponent. Every step is exact, because the result is a multiple
+ * of the smallest double and its mantissa fits in 53 bits. */
+static double scale_by_power_of_two(double value, long exponent) {
+    for (; exponent >= 32; exponent -= 32) {
+        value *= 4294967296.0;
+    }
+    for (; exponent <= -32; exponent += 32) {
+        value /= 4294967296.0;
+    }
+    return (exponent >= 0) ? (value * (double)(1UL << exponent)) : (value / (double)(1UL << -exponent));
+}
+
+/* Converts the number, which is first scaled by powers of two to the range [0.5, 1). The
+ * shifts are the largest ones that keep it in the range, for each position of the decimal
+ * point. Then the 53 bits of the mantissa are extracted and rounded. */
+static double decimal_to_double(struct Ini_Decimal *const decimal) {
+    static const int shifts[] = {1, 3, 6, 9, 13, 16, 19, 23, 26};
+    const long max_shift_point = (long)(sizeof(shifts) / sizeof(shifts[0]));
+    long exponent = 0;
+    double mantissa;
+    if (decimal->digits == 0) {
+        return 0.0;
+    }
+    if (decimal->point > 310) {
+        return HUGE_VAL;
+    }
+    if (decimal->point < -330) {
+        return 0.0;
+    }
+    while (decimal->point > 0) {
+        const int shift = (decimal->point >= max_shift_point) ? 27 : shifts[decimal->point];
+        decimal_shift(decimal, -shift);
+        exponent += shift;
+    }
+    while ((decimal->point < 0) || ((decimal->point == 0) && (decimal->d[0] < 5))) {
+        const int shift = (-decimal->point >= max_shift_point) ? 27 : shifts[-decimal->point];
+        decimal_shift(decimal, shift);
+        exponent -= shift;
+    }
+    /* The mantissas of the doubles are in the range [1, 2) */
+    exponent--;
+    /* The subnormal numbers have the smallest exponent and fewer bits */
+    if (exponent < -1022) {
+        decimal_shift(decimal, (int)(exponent + 1022));
+        exponent = -1022;
+    }
+    if (exponent > 1023) {
+        return HUGE_VAL;
+    }
+    decimal_shift(decimal, 53);
+    mantissa = decimal_rounded_integer(decimal);
+    /* The rounding may carry to the next power of two (2^53) */
+    if (mantissa == 9007199254740992.0) {
+        mantissa /= 2.0;
+        exponent++;
+        if (exponent > 1023) {
+            return HUGE_VAL;
+        }
+    }
+    return scale_by_power_of_two(mantissa, exponent - 52);
+}
+
+/* The numbers whose mantissa fits in 53 bits and whose exponent is at most 22 are converted
+ * by a single multiplication or division of exact values, which is correctly rounded. The
+ * others are converted by decimal_to_double. The numbers too large for a double are
+ * converted to infinity, like strtod, which is also accepted as inf or infinity, and so is
+ * nan. The hexadecimal numbers aren't accepted. */
+Ini_File_Error ini_convert_double(const char *const value, const size_t value_len, double *const real) {
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char *str = value, *const str_end = value + value_len, *mantissa_start, *mantissa_end;
+    struct Ini_Decimal decimal;
+    double mantissa = 0.0;
+    long exponent = 0, exponent_digits = 0;
+    int negative = 0, digits = 0, exact = 1, exponent_negative = 0;
+    if ((value == NULL) || (real == NULL)) {
+        return ini_invalid_parameters;
+    }
+    if ((str < str_end) && ((*str == '-') || (*str == '+'))) {
+        negative = (*str++ == '-');
+    }
+    if (ascii_equals_ignoring_case(str, (size_t)(str_end - str), "inf") || ascii_equals_ignoring_case(str, (size_t)(str_end - str), "infinity")) {
+        *real = negative ? -HUGE_VAL : HUGE_VAL;
+        return ini_no_error;
+    }
+    if (ascii_equals_ignoring_case(str, (size_t)(str_end - str), "nan")) {
+        *real = HUGE_VAL - HUGE_VAL;
+        return ini_no_error;
+    }
+    mantissa_start = str;
+    for (; (str < str_end) && (*str >= '0') && (*str <= '9'); str++, digits++) {
+        exact = exact && (mantissa < MAX_EXACT_MANTISSA);
+        mantissa = mantissa * 10.0 + (double)(*str - '0');
+    }
+    if ((str < str_end) && (*str == '.')) {
+        for (str++; (str < str_end) && (*str >= '0') && (*str <= '9'); str++, digits++) {
+            exact = exact && (mantissa < MAX_EXACT_MANTISSA);
+            mantissa = mantissa * 10.0 + (double)(*str - '0');
+            exponent--;
+        }
+    }
+    mantissa_end = str;
+    if ((digits > 0) && (str < str_end) && ((*str == 'e') || (*str == 'E'))) {
+        const char *exponent_start;
+        str++;
+        if ((str < str_end) && ((*str == '-') || (*str == '+'))) {
+            exponent_negative = (*str++ == '-');
+        }
+        for (exponent_start = str; (str < str_end) && (*str >= '0') && (*str <= '9'); str++) {
+            if (exponent_digits < DECIMAL_MAX_EXPONENT) {
+                exponent_digits = exponent_digits * 10 + (*str - '0');
+            }
+        }
+        if (str == exponent_start) {
+            return ini_not_double;
+        }
+        if (exponent_negative) {
+            exponent_digits = -exponent_digits;
+        }
+        exponent += exponent_digits;
+    }
+    if ((str != str_end) || (digits == 0)) {
+        return ini_not_double;
+    }
+    if (exact && (exponent >= -22) && (exponent <= 22)) {
+        mantissa = (exponent < 0) ? (mantissa / powers_of_ten[-exponent]) : (mantissa * powers_of_ten[exponent]);
+    } else {
+        decimal_parse(&decimal, mantissa_start, mantissa_end, exponent_digits);
+        mantissa = decimal_to_double(&decimal);
+    }
+    *real = negative ? -mantissa : mantissa;
+    return ini_no_error;
+}
+
+Ini_File_Error ini_convert_boolean(const char *const value, const size_t value_len, int *const boolean) {
+    static const char *const names[] = {"false", "true", "no", "yes", "off", "on", "0", "1"};
+    size_t i;
+    if ((value == NULL) || (boolean == NULL)) {
+        return ini_invalid_parameters;
+    }
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (ascii_equals_ignoring_case(value, value_len, names[i])) {
+            *boolean = (int)(i % 2);
+            return ini_no_error;
+        }
+    }
+    return ini_not_boolean;
+}
+
+Ini_File_Error ini_convert_size(const char *const value, const size_t value_len, unsigned long *const size) {
+    static const char suffixes[] = "kmgtpe";
+    const char *str = value, *suffix, *end = value + value_len;
+    unsigned long number;
+    size_t shift = 0;
+    if ((value == NULL) || (size == NULL)) {
+        return ini_invalid_parameters;
+    }
+    if ((value_len > 0) && (*str == '+')) {
+        str++;
+    }
+    if (!parse_unsigned_digits(str, end, 0, &number, &str)) {
+        return ini_not_size;
+    }
+    /* The suffixes are powers of 1024, which may be followed by "B" or "iB" */
+    if ((str < end) && (*str != '\0') && ((suffix = strchr(suffixes, ascii_lower(*str))) != NULL)) {
+        shift = 10 * (size_t)(suffix - suffixes + 1);
+        str++;
+        if (((end - str) == 2) && (ascii_lower(str[0]) == 'i')) {
+            str++;
+        }
+    }
+    if (((end - str) == 1) && (ascii_lower(*str) == 'b')) {
+        str++;
+    }
+    if (str != end) {
+        return ini_not_size;
+    }
+    if ((shift >= sizeof(unsigned long) * CHAR_BIT) ? (number != 0) : (number > (ULONG_MAX >> shift))) {
+        return ini_not_size;
+    }
+    *size = (shift >= sizeof(unsigned long) * CHAR_BIT) ? 0 : (number << shift);
+    return ini_no_error;
+}
+
+Ini_File_Error ini_convert_duration(const char *const value, const size_t value_len, double *const seconds) {
+    static const struct {
+        const char *suffix;
+        double seconds;
+    } units[] = {
+        {"ns", 1e-9}, {"us", 1e-6}, {"ms", 1e-3}, {"min", 60.0},
+        {"s", 1.0}, {"m", 60.0}, {"h", 3600.0}, {"d", 86400.0}
+    };
+    double number, unit = 1.0;
+    size_t i, len = value_len, digits = 0;
+    int point = 0;
+    if ((value == NULL) || (seconds == NULL)) {
+        return ini_invalid_parameters;
+    }
+    for (i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+        const size_t suffix_len = strlen(units[i].suffix);
+        if ((suffix_len < value_len) && ascii_equals_ignoring_case(&value[value_len - suffix_len], suffix_len, units[i].suffix)) {
+            len = value_len - suffix_len;
+            unit = units[i].seconds;
+            break;
+        }
+    }
+    /* Unlike the doubles, the number has only decimal digits and an optional fraction, so
+     * the signs, exponents, inf and nan aren't accepted */
+    for (i = 0; i < len; i++) {
+        if ((value[i] == '.') && !point) {
+            point = 1;
+        } else if ((value[i] >= '0') && (value[i] <= '9')) {
+            digits++;
+        } else {
+            return ini_not_duration;
+        }
+    }
+    if ((digits == 0) || (ini_convert_double(value, len, &number) != ini_no_error)) {
+        return ini_not_duration;
+    }
+    *seconds = number * unit;
+    return ini_no_error;
+}
+
+/* Types of the values stored in the cache of the sections (see Ini_Section::cached_values) */
+enum Ini_Cached_Type {
+    cached_none = 0,
+    cached_busy,
+    cached_integer,
+    cached_unsigned,
+    cached_double,
+    cached_boolean,
+    cached_size,
+    cached_duration
+};
+
+/* Returns the element of the cache of the section that corresponds to the property, or NULL
+ * if the cache couldn't be allocated, in which case the value is just converted */
+static struct Ini_Cached_Value *ini_section_cached_value(const struct Ini_Section *const ini_section, const struct Key_Value_Pair *const property) {
+    return (ini_section->cached_values != NULL) ? &ini_section->cached_values[property - ini_section->properties] : NULL;
+}
+
+/* Converts the value of the property, using its element of the cache, if provided. Only the
+ * first conversion is cached, so a value read as different types is converted every time for
+ * the other types. The thread that reserves the empty element stores the result and then
+ * publishes its type, so the other threads either see the complete result or convert the
+ * value themselves. */
+#ifdef USE_VALUE_CACHE
+#define cached_conversion_function(name, type, field, cached_type_of_value, convert) \
+    static Ini_File_Error name(struct Ini_Cached_Value *const cached, const struct Key_Value_Pair *const property, type *const result) { \
+        int expected = cached_none; \
+        Ini_File_Error error; \
+        if ((cached != NULL) && (atomic_load(&cached->cached_type) == cached_type_of_value)) { \
+            *result = cached->value.field; \
+            return ini_no_error; \
+        } \
+        error = convert(property->value, property->value_len, result); \
+        if ((error == ini_no_error) && (cached != NULL) && atomic_compare_exchange(&cached->cached_type, &expected, cached_busy)) { \
+            cached->value.field = *result; \
+            atomic_store(&cached->cached_type, cached_type_of_value); \
+        } \
+        return error; \
+    }
+#else
+#define cached_conversion_function(name, type, field, cached_type_of_value, convert) \
+    static Ini_File_Error name(struct Ini_Cached_Value *const cached, const struct Key_Value_Pair *const property, type *const result) { \
+        (void)cached; \
+        return convert(property->value, property->value_len, result); \
+    }
+#endif
+
+cached_conversion_function(property_to_integer, long, integer, cached_integer, ini_convert_integer)
+cached_conversion_function(property_to_unsigned, unsigned long, uint, cached_unsigned, ini_convert_unsigned)
+cached_conversion_function(property_to_double, double, real, cached_double, ini_convert_double)
+cached_conversion_function(property_to_boolean, int, boolean, cached_boolean, ini_convert_boolean)
+cached_conversion_function(property_to_size, unsigned long, uint, cached_size, ini_convert_size)
+cached_conversion_function(property_to_duration, double, real, cached_duration, ini_convert_duration)
+
+/* Defines the functions ini_section_find_<suffix> and ini_file_find_<suffix>, which find the
+ * property and convert its value with the function property_to_<suffix> */
+#define typed_find_functions(suffix, type) \
+    Ini_File_Error ini_section_find_ ## suffix(struct Ini_Section *const ini_section, const char *const key, type *const result) { \
+        struct Key_Value_Pair *property; \
+        Ini_File_Error error; \
+        if (result == NULL) { \
+            return ini_invalid_parameters; \
+        } \
+        error = ini_section_find_pair(ini_section, key, &property); \
+        if (error != ini_no_error) { \
+            return error; \
+        } \
+        return property_to_ ## suffix(ini_section_cached_value(ini_section, property), property, result); \
+    } \
+    Ini_File_Error ini_file_find_ ## suffix(struct Ini_File *const ini_file, const char *const section, const char *const key, type *const result) { \
+        struct Ini_Section *ini_section; \
+        Ini_File_Error error; \
+        if ((result == NULL) || (key == NULL)) { \
+            return ini_invalid_parameters; \
+        } \
+        error = ini_file_find_section(ini_file, section, &ini_section); \
+        if (error != ini_no_error) { \
+            return error; \
+        } \
+        return ini_section_find_ ## suffix(ini_section, key, result); \
+    }
+
+typed_find_functions(integer, long)
+typed_find_functions(unsigned, unsigned long)
+typed_find_functions(double, double)
+typed_find_functions(boolean, int)
+typed_find_functions(size, unsigned long)
+typed_find_functions(duration, double)
+
+/* The iterators find the positions of the first and last elements in the sorted arrays, and
+ * then just walk between them. NULL bounds of the ranges are the ends of the arrays. */
+Ini_File_Error ini_section_iter_prefix(struct Ini_Section *const ini_section, const char *const prefix, struct Ini_Property_Iterator *const iterator) {
+    size_t len;
+    if ((ini_section == NULL) || (prefix == NULL) || (iterator == NULL)) {
+        return ini_invalid_parameters;
+    }
+    len = strlen(prefix);
+    iterator->properties = ini_section->properties;
+    iterator->index = property_lower_bound(ini_section->properties, 0, ini_section->properties_size, prefix, len, 0);
+    iterator->end = property_lower_bound(ini_section->properties, iterator->index, ini_section->properties_size, prefix, len, 1);
+    return ini_no_error;
+}
+
+Ini_File_Error ini_section_iter_range(struct Ini_Section *const ini_section, const char *const low, const char *const high, struct Ini_Property_Iterator *const iterator) {
+    if ((ini_section == NULL) || (iterator == NULL)) {
+        return ini_invalid_parameters;
+    }
+    iterator->properties = ini_section->properties;
+    iterator->index = (low == NULL) ? 0 : property_lower_bound(ini_section->properties, 0, ini_section->properties_size, low, strlen(low), 0);
+    iterator->end = (high == NULL) ? ini_section->properties_size : property_lower_bound(ini_section->properties, 0, ini_section->properties_size, high, strlen(high), 0);
+    iterator->end = max_size(iterator->index, iterator->end);
+    return ini_no_error;
+}
+
+Key_Value_Pair *ini_property_iter_next(struct Ini_Property_Iterator *const iterator) {
+    if ((iterator == NULL) || (iterator->index >= iterator->end)) {
+        return NULL;
+    }
+    return &iterator->properties[iterator->index++];
+}
+
+/* The properties aren't sorted during the bulk load, which only the file knows about */
+Ini_File_Error ini_file_iter_properties_prefix(struct Ini_File *const ini_file, const char *const section, const char *const prefix, struct Ini_Property_Iterator *const iterator) {
+    struct Ini_Section *ini_section;
+    Ini_File_Error error;
+    if ((ini_file == NULL) || (ini_file->flags & ini_bulk_load)) {
+        return ini_invalid_parameters;
+    }
+    error = ini_file_find_section(ini_file, section, &ini_section);
+    if (error != ini_no_error) {
+        return error;
+    }
+    return ini_section_iter_prefix(ini_section, prefix, iterator);
+}
+
+Ini_File_Error ini_file_iter_properties_range(struct Ini_File *const ini_file, const char *const section, const char *const low, const char *const high, struct Ini_Property_Iterator *const iterator) {
+    struct Ini_Section *ini_section;
+    Ini_File_Error error;
+    if ((ini_file == NULL) || (ini_file->flags & ini_bulk_load)) {
+        return ini_invalid_parameters;
+    }
+    error = ini_file_find_section(ini_file, section, &ini_section);
+    if (error != ini_no_error) {
+        return error;
+    }
+    return ini_section_iter_range(ini_section, low, high, iterator);
+}
+
+Ini_File_Error ini_file_iter_sections_prefix(struct Ini_File *const ini_file, const char *const prefix, struct Ini_Section_Iterator *const iterator) {
+    size_t len;
+    if ((ini_file == NULL) || (prefix == NULL) || (iterator == NULL) || (ini_file->flags & ini_bulk_load)) {
+        return ini_invalid_parameters;
+    }
+    len = strlen(prefix);
+    iterator->sections = ini_file->sections;
+    iterator->index = section_lower_bound(ini_file->sections, 0, ini_file->sections_size, prefix, len, 0);
+    iterator->end = section_lower_bound(ini_file->sections, iterator->index, ini_file->sections_size, prefix, len, 1);
+    return ini_no_error;
+}
+
+Ini_File_Error ini_file_iter_sections_range(struct Ini_File *const ini_file, const char *const low, const char *const high, struct Ini_Section_Iterator *const iterator) {
+    if ((ini_file == NULL) || (iterator == NULL) || (ini_file->flags & ini_bulk_load)) {
+        return ini_invalid_parameters;
+    }
+    iterator->sections = ini_file->sections;
+    iterator->index = (low == NULL) ? 0 : section_lower_bound(ini_file->sections, 0, ini_file->sections_size, low, strlen(low), 0);
+    iterator->end = (high == NULL) ? ini_file->sections_size : section_lower_bound(ini_file->sections, 0, ini_file->sections_size, high, strlen(high), 0);
+    iterator->end = max_size(iterator->index, iterator->end);
+    return ini_no_error;
+}
+
+Ini_Section *ini_section_iter_next(struct Ini_Section_Iterator *const iterator) {
+    if ((iterator == NULL) || (iterator->index >= iterator->end)) {
+        return NULL;
+    }
+    return &iterator->sections[iterator->index++];
+}
+
+/* Last version given to a structure by ini_file_resolve. The versions are unique in the
+ * process, so a handle isn't accepted by another structure, even if it is allocated at the
+ * same address after the first one is released. */
+static size_t last_handle_version = 0;
+
+Ini_File_Error ini_file_resolve(struct Ini_File *const ini_file, const char *const section, const char *const key, struct Ini_Handle *const handle) {
+    struct Ini_Section *ini_section;
+    struct Key_Value_Pair *property;
+    Ini_File_Error error;
+    if ((handle == NULL) || (key == NULL) || ((ini_file != NULL) && (ini_file->flags & ini_bulk_load))) {
+        return ini_invalid_parameters;
+    }
+    error = ini_file_find_section(ini_file, section, &ini_section);
+    if (error != ini_no_error) {
+        return error;
+    }
+    error = ini_section_find_pair(ini_section, key, &property);
+    if (error != ini_no_error) {
+        return error;
+    }
+    if (ini_file->version == 0) {
+#ifdef USE_ATOMIC_OPERATIONS
+        ini_file->version = atomic_add(&last_handle_version, 1) + 1;
+#else
+        ini_file->version = ++last_handle_version;
+#endif
+    }
+    handle->version = ini_file->version;
+    handle->property = property;
+    /* The elements of the cache are moved only when the version changes, so the handle can
+     * keep its element. It's allocated here if it couldn't be allocated before. */
+    ini_section_reserve_cache(ini_file, ini_section, ini_section->properties_capacity);
+    handle->cached_value = ini_section_cached_value(ini_section, property);
+    return ini_no_error;
+}
+
+/* The handles are checked by their versions, which are never zero */
+static Ini_File_Error ini_handle_check(const struct Ini_File *const ini_file, const struct Ini_Handle *const handle) {
+    if ((ini_file == NULL) || (handle == NULL)) {
+        return ini_invalid_parameters;
+    }
+    if ((handle->version == 0) || (handle->version != ini_file->version)) {
+        return ini_stale_handle;
+    }
+    return ini_no_error;
+}
+
+Ini_File_Error ini_handle_get_property(const struct Ini_File *const ini_file, const struct Ini_Handle *const handle, char **const value) {
+    const Ini_File_Error error = ini_handle_check(ini_file, handle);
+    if (value == NULL) {
+        return ini_invalid_parameters;
+    }
+    if (error == ini_no_error) {
+        *value = handle->property->value;
+    }
+    return error;
+}
+
+Ini_File_Error ini_handle_get_integer(const struct Ini_File *const ini_file, const struct Ini_Handle *const handle, long *const integer) {
+    const Ini_File_Error error = ini_handle_check(ini_file, handle);
+    if (integer == NULL) {
+        return ini_invalid_parameters;
+    }
+    if (error != ini_no_error) {
+        return error;
+    }
+    return property_to_integer(handle->cached_value, handle->property, integer);
+}
+
+Ini_File_Error ini_handle_get_unsigned(const struct Ini_File *const ini_file, const struct Ini_Handle *const handle, unsigned long *const uint) {
+    const Ini_File_Error error = ini_handle_check(ini_file, handle);
+    if (uint == NULL) {
+        return ini_invalid_parameters;
+    }
+    if (error != ini_no_error) {
+        return error;
+    }
+    return property_to_unsigned(handle->cached_value, handle->property, uint);
+}
+
+Ini_File_Error ini_handle_get_double(const struct Ini_File *const ini_file, const struct Ini_Handle *const handle, double *const real) {
+    const Ini_File_Error error = ini_handle_check(ini_file, handle);
+    if (real == NULL) {
+        return ini_invalid_parameters;
+    }
+    if (error != ini_no_error) {
+        return error;
+    }
+    return property_to_double(handle->cached_value, handle->property, real);
+}
+
+Ini_File_Error ini_handle_get_boolean(const struct Ini_File *const ini_file, const struct Ini_Handle *const handle, int *const boolean) {
+    const Ini_File_Error error = ini_handle_check(ini_file, handle);
+    if (boolean == NULL) {
+        return ini_invalid_parameters;
+    }
+    if (error != ini_no_error) {
+        return error;
+    }
+    return property_to_boolean(handle->cached_value, handle->property, boolean);
+}
+
+Ini_File_Error ini_handle_get_size(const struct Ini_File *const ini_file, const struct Ini_Handle *const handle, unsigned long *const size) {
+    const Ini_File_Error error = ini_handle_check(ini_file, handle);
+    if (size == NULL) {
+        return ini_invalid_parameters;
+    }
+    if (error != ini_no_error) {
+        return error;
+    }
+    return property_to_size(handle->cached_value, handle->property, size);
+}
+
+Ini_File_Error ini_handle_get_duration(const struct Ini_File *const ini_file, const struct Ini_Handle *const handle, double *const seconds) {
+    const Ini_File_Error error = ini_handle_check(ini_file, handle);
+    if (seconds == NULL) {
+        return ini_invalid_parameters;
+    }
+    if (error != ini_no_error) {
+        return error;
+    }
+    return property_to_duration(handle->cached_value, handle->property, seconds);
+}
+
+/* The snapshot is stored in a single block of memory, which doesn't contain pointers: the
+ * strings are referenced by their offsets from the beginning of the block. The header is
+ * followed by the array of sections (the global section is the first one), the array of
+ * properties of all the sections, the optional hash tables and the null-terminated strings.
+ * So the block can be written to a file or shared memory and used as it is. */
+struct Ini_Snapshot_Section {
+    size_t name;
+    size_t name_len;
+    /* Index of the first property of the section */
+    size_t properties;
+    size_t properties_size;
+};
+
+struct Ini_Snapshot_Property {
+    size_t key;
+    size_t key_len;
+    size_t value;
+    size_t value_len;
+};
+
+struct Ini_Snapshot {
+    /* Size of the whole block, in bytes */
+    size_t size;
+    /* Number of sections, including the global section */
+    size_t sections_size;
+    size_t properties_size;
+    /* Capacities of the hash tables, which are zero if the snapshot has no index. The table of
+     * the properties is indexed by the key and the position of the section they belong to. */
+    size_t sections_index_capacity;
+    size_t properties_index_capacity;
+};
+
+#define snapshot_string(snapshot, offset) ((const char *)(snapshot) + (offset))
+#define snapshot_sections(snapshot) ((const struct Ini_Snapshot_Section *)((snapshot) + 1))
+#define snapshot_properties(snapshot) ((const struct Ini_Snapshot_Property *)(snapshot_sections(snapshot) + (snapshot)->sections_size))
+#define snapshot_sections_index(snapshot) ((const size_t *)(snapshot_properties(snapshot) + (snapshot)->properties_size))
+#define snapshot_properties_index(snapshot) (snapshot_sections_index(snapshot) + (snapshot)->sections_index_capacity)
+#define snapshot_property_hash(key, len, section_index) (hash_sized_string(key, len) ^ ((section_index) * 2654435761UL))
+
+/* Smallest power of two that is at least twice the number of elements */
+static size_t snapshot_index_capacity(const size_t elements) {
+    size_t capacity = 2;
+    while (capacity < 2 * elements) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static void snapshot_index_put(size_t *const table, const size_t capacity, const size_t hash, const size_t index) {
+    size_t slot = hash & (capacity - 1);
+    while (table[slot] != 0) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    table[slot] = index + 1;
+}
+
+/* Fills the hash tables of a snapshot built with the flag ini_hash_index */
+static void snapshot_build_index(struct Ini_Snapshot *const snapshot) {
+    const struct Ini_Snapshot_Section *const sections = snapshot_sections(snapshot);
+    const struct Ini_Snapshot_Property *const properties = snapshot_properties(snapshot);
+    size_t *const sections_index = (size_t *)snapshot_sections_index(snapshot);
+    size_t *const properties_index = sections_index + snapshot->sections_index_capacity;
+    size_t i, j;
+    memset(sections_index, 0, (snapshot->sections_index_capacity + snapshot->properties_index_capacity) * sizeof(size_t));
+    for (i = 0; i < snapshot->sections_size; i++) {
+        if (i > 0) {
+            snapshot_index_put(sections_index, snapshot->sections_index_capacity,
+                hash_sized_string(snapshot_string(snapshot, sections[i].name), sections[i].name_len), i);
+        }
+        for (j = sections[i].properties; j < sections[i].properties + sections[i].properties_size; j++) {
+            snapshot_index_put(properties_index, snapshot->properties_index_capacity,
+                snapshot_property_hash(snapshot_string(snapshot, properties[j].key), properties[j].key_len, i), j);
+        }
+    }
+}
+
+static size_t ini_section_strings_size(const struct Ini_Section *const ini_section) {
+    size_t i, size = ini_section->name_len + 1;
+    for (i = 0; i < ini_section->properties_size; i++) {
+        size += ini_section->properties[i].key_len + ini_section->properties[i].value_len + 2;
+    }
+    return size;
+}
+
+static size_t snapshot_store_string(char *const block, size_t *const offset, const char *const str, const size_t len) {
+    const size_t position = *offset;
+    if (len > 0) {
+        memcpy(&block[position], str, len);
+    }
+    block[position + len] = '\0';
+    *offset += len + 1;
+    return position;
+}
+
+static void snapshot_store_section(char *const block, const struct Ini_Section *const ini_section, struct Ini_Snapshot_Section *const section, struct Ini_Snapshot_Property *const properties, size_t *const offset) {
+    size_t i;
+    section->name = snapshot_store_string(block, offset, ini_section->name, ini_section->name_len);
+    section->name_len = ini_section->name_len;
+    section->properties_size = ini_section->properties_size;
+    for (i = 0; i < ini_section->properties_size; i++) {
+        const struct Key_Value_Pair *const pair = &ini_section->properties[i];
+        struct Ini_Snapshot_Property *const property = &properties[section->properties + i];
+        property->key = snapshot_store_string(block, offset, pair->key, pair->key_len);
+        property->key_len = pair->key_len;
+        property->value = snapshot_store_string(block, offset, pair->value, pair->value_len);
+        property->value_len = pair->value_len;
+    }
+}
+
+struct Ini_Snapshot *ini_file_freeze(const struct Ini_File *const ini_file) {
+    struct Ini_Snapshot *snapshot;
+    struct Ini_Snapshot_Section *sections;
+    struct Ini_Snapshot_Property *properties;
+    size_t i, offset, properties_size, strings_size;
+    size_t sections_index_capacity = 0, properties_index_capacity = 0;
+    /* The arrays aren't sorted during the bulk load */
+    if ((ini_file == NULL) || (ini_file->flags & ini_bulk_load)) {
+        return NULL;
+    }
+    properties_size = ini_file->global_section.properties_size;
+    strings_size = ini_section_strings_size(&ini_file->global_section);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        properties_size += ini_file->sections[i].properties_size;
+        strings_size += ini_section_strings_size(&ini_file->sections[i]);
+    }
+    if (ini_file->flags & ini_hash_index) {
+        sections_index_capacity = snapshot_index_capacity(ini_file->sections_size);
+        properties_index_capacity = snapshot_index_capacity(properties_size);
+    }
+    offset = sizeof(struct Ini_Snapshot) +
+        (ini_file->sections_size + 1) * sizeof(struct Ini_Snapshot_Section) +
+        properties_size * sizeof(struct Ini_Snapshot_Property) +
+        (sections_index_capacity + properties_index_capacity) * sizeof(size_t);
+    snapshot = malloc(offset + strings_size);
+    if (snapshot == NULL) {
+        return NULL;
+    }
+    snapshot->size = offset + strings_size;
+    snapshot->sections_size = ini_file->sections_size + 1;
+    snapshot->properties_size = properties_size;
+    snapshot->sections_index_capacity = sections_index_capacity;
+    snapshot->properties_index_capacity = properties_index_capacity;
+    sections = (struct Ini_Snapshot_Section *)(snapshot + 1);
+    properties = (struct Ini_Snapshot_Property *)(sections + snapshot->sections_size);
+    sections[0].properties = 0;
+    snapshot_store_section((char *)snapshot, &ini_file->global_section, &sections[0], properties, &offset);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        sections[i + 1].properties = sections[i].properties + sections[i].properties_size;
+        snapshot_store_section((char *)snapshot, &ini_file->sections[i], &sections[i + 1], properties, &offset);
+    }
+    if (sections_index_capacity > 0) {
+        snapshot_build_index(snapshot);
+    }
+    return snapshot;
+}
+
+void ini_snapshot_free(struct Ini_Snapshot *const snapshot) {
+    free(snapshot);
+}
+
+/* Binary search over the sorted arrays of the snapshot, which returns the element found or NULL */
+#define snapshot_binary_search(snapshot, array, size, elem, str, len) \
+    do { \
+        size_t low = 0; \
+        size_t high = size; \
+        while (low < high) { \
+            const size_t middle = low + (high - low) / 2; \
+            const int comp = compare_sized_strings(str, len, snapshot_string(snapshot, array[middle].elem), array[middle].elem ## _len); \
+            if (comp < 0) { \
+                high = middle; \
+            } else if (comp > 0) { \
+                low = middle + 1; \
+            } else { \
+                return &array[middle]; \
+            } \
+        } \
+        return NULL; \
+    } while (0)
+
+static const struct Ini_Snapshot_Section *ini_snapshot_lookup_section(const struct Ini_Snapshot *const snapshot, const char *const section) {
+    const struct Ini_Snapshot_Section *const sections = snapshot_sections(snapshot);
+    const size_t *const table = snapshot_sections_index(snapshot);
+    size_t section_len, slot;
+    if ((section == NULL) || (section[0] == '\0')) {
+        return &sections[0];
+    }
+    section_len = strlen(section);
+    if (snapshot->sections_index_capacity > 0) {
+        slot = hash_sized_string(section, section_len) & (snapshot->sections_index_capacity - 1);
+        while (table[slot] != 0) {
+            const struct Ini_Snapshot_Section *const candidate = &sections[table[slot] - 1];
+            if (compare_sized_strings(section, section_len, snapshot_string(snapshot, candidate->name), candidate->name_len) == 0) {
+                return candidate;
+            }
+            slot = (slot + 1) & (snapshot->sections_index_capacity - 1);
+        }
+        return NULL;
+    }
+    /* The global section isn't part of the sorted array */
+    snapshot_binary_search(snapshot, (sections + 1), (snapshot->sections_size - 1), name, section, section_len);
+}
+
+static const struct Ini_Snapshot_Property *ini_snapshot_lookup_key(const struct Ini_Snapshot *const snapshot, const struct Ini_Snapshot_Section *const section, const char *const key) {
+    const struct Ini_Snapshot_Property *const properties = snapshot_properties(snapshot) + section->properties;
+    const size_t *const table = snapshot_properties_index(snapshot);
+    const size_t key_len = strlen(key);
+    size_t slot;
+    if (snapshot->properties_index_capacity > 0) {
+        const size_t section_index = (size_t)(section - snapshot_sections(snapshot));
+        slot = snapshot_property_hash(key, key_len, section_index) & (snapshot->properties_index_capacity - 1);
+        while (table[slot] != 0) {
+            /* The keys of the other sections are also stored in the table */
+            const size_t index = table[slot] - 1 - section->properties;
+            if ((index < section->properties_size) &&
+                (compare_sized_strings(key, key_len, snapshot_string(snapshot, properties[index].key), properties[index].key_len) == 0)) {
+                return &properties[index];
+            }
+            slot = (slot + 1) & (snapshot->properties_index_capacity - 1);
+        }
+        return NULL;
+    }
+    snapshot_binary_search(snapshot, properties, section->properties_size, key, key, key_len);
+}
+
+Ini_File_Error ini_snapshot_find_sized(const struct Ini_Snapshot *const snapshot, const char *const section, const char *const key, const char **const value, size_t *const value_len) {
+    const struct Ini_Snapshot_Section *ini_section;
+    const struct Ini_Snapshot_Property *property;
+    if ((snapshot == NULL) || (key == NULL) || (value == NULL)) {
+        return ini_invalid_parameters;
+    }
+    if (key[0] == '\0') {
+        return ini_invalid_parameters;
+    }
+    ini_section = ini_snapshot_lookup_section(snapshot, section);
+    if (ini_section == NULL) {
+        return ini_no_such_section;
+    }
+    property = ini_snapshot_lookup_key(snapshot, ini_section, key);
+    if (property == NULL) {
+        return ini_no_such_property;
+    }
+    *value = snapshot_string(snapshot, property->value);
+    if (value_len != NULL) {
+        *value_len = property->value_len;
+    }
+    return ini_no_error;
+}
+
+Ini_File_Error ini_snapshot_find_property(const struct Ini_Snapshot *const snapshot, const char *const section, const char *const key, const char **const value) {
+    return ini_snapshot_find_sized(snapshot, section, key, value, NULL);
+}
+
+Ini_File_Error ini_snapshot_find_integer(const struct Ini_Snapshot *const snapshot, const char *const section, const char *const key, long *const integer) {
+    const char *value;
+    size_t value_len;
+    Ini_File_Error error;
+    if (integer == NULL) {
+        return ini_invalid_parameters;
+    }
+    error = ini_snapshot_find_sized(snapshot, section, key, &value, &value_len);
+    if (error != ini_no_error) {
+        return error;
+    }
+    return ini_convert_integer(value, value_len, integer);
+}
+
+Ini_File_Error ini_snapshot_find_unsigned(const struct Ini_Snapshot *const snapshot, const char *const section, const char *const key, unsigned long *const uint) {
+    const char *value;
+    size_t value_len;
+    Ini_File_Error error;
+    if (uint == NULL) {
+        return ini_invalid_parameters;
+    }
+    error = ini_snapshot_find_sized(snapshot, section, key, &value, &value_len);
+    if (error != ini_no_error) {
+        return error;
+    }
+    return ini_convert_unsigned(value, value_len, uint);
+}
+
+Ini_File_Error ini_snapshot_find_double(const struct Ini_Snapshot *const snapshot, const char *const section, const char *const key, double *const real) {
+    const char *value;
+    size_t value_len;
+    Ini_File_Error error;
+    if (real == NULL) {
+        return ini_invalid_parameters;
+    }
+    error = ini_snapshot_find_sized(snapshot, section, key, &value, &value_len);
+    if (error != ini_no_error) {
+        return error;
+    }
+    return ini_convert_double(value, value_len, real);
+}
+
+Ini_File_Error ini_snapshot_find_boolean(const struct Ini_Snapshot *const snapshot, const char *const section, const char *const key, int *const boolean) {
+    const char *value;
+    size_t value_len;
+    Ini_File_Error error;
+    if (boolean == NULL) {
+        return ini_invalid_parameters;
+    }
+    error = ini_snapshot_find_sized(snapshot, section, key, &value, &value_len);
+    if (error != ini_no_error) {
+        return error;
+    }
+    return ini_convert_boolean(value, value_len, boolean);
+}
+
+Ini_File_Error ini_snapshot_find_size(const struct Ini_Snapshot *const snapshot, const char *const section, const char *const key, unsigned long *const size) {
+    const char *value;
+    size_t value_len;
+    Ini_File_Error error;
+    if (size == NULL) {
+        return ini_invalid_parameters;
+    }
+    error = ini_snapshot_find_sized(snapshot, section, key, &value, &value_len);
+    if (error != ini_no_error) {
+        return error;
+    }
+    return ini_convert_size(value, value_len, size);
+}
+
+Ini_File_Error ini_snapshot_find_duration(const struct Ini_Snapshot *const snapshot, const char *const section, const char *const key, double *const seconds) {
+    const char *value;
+    size_t value_len;
+    Ini_File_Error error;
+    if (seconds == NULL) {
+        return ini_invalid_parameters;
+    }
+    error = ini_snapshot_find_sized(snapshot, section, key, &value, &value_len);
+    if (error != ini_no_error) {
+        return error;
+    }
+    return ini_convert_duration(value, value_len, seconds);
+}
+
+void ini_snapshot_print_to(const struct Ini_Snapshot *const snapshot, FILE *const sink) {
+    size_t section_index, property_index;
+    if (snapshot == NULL) {
+        return;
+    }
+    for (section_index = 0; section_index < snapshot->sections_size; section_index++) {
+        const struct Ini_Snapshot_Section *const section = &snapshot_sections(snapshot)[section_index];
+        const struct Ini_Snapshot_Property *const properties = snapshot_properties(snapshot) + section->properties;
+        /* The global section is printed only if it has properties */
+        if ((section_index == 0) && (section->properties_size == 0)) {
+            continue;
+        }
+        if (section->name_len > 0) {
+            fprintf(sink, "[%s]\n", snapshot_string(snapshot, section->name));
+        }
+        for (property_index = 0; property_index < section->properties_size; property_index++) {
+            fprintf(sink, "%s = %s\n", snapshot_string(snapshot, properties[property_index].key), snapshot_string(snapshot, properties[property_index].value));
+        }
+        fputc('\n', sink);
+    }
+}
+
+/* The compiled images start with this header, which is followed by the snapshot. They can
+ * only be opened by programs built for the same architecture, which is checked by the size
+ * of the words and their byte order. */
+#define INI_COMPILED_MAGIC "INI-IMG"
+#define INI_COMPILED_VERSION 1
+#define INI_COMPILED_BYTE_ORDER 0x01020304UL
+
+struct Ini_Compiled_Header {
+    char magic[8];
+    size_t version;
+    size_t word_size;
+    size_t byte_order;
+    size_t checksum;
+};
+
+/* Variation of the FNV-1a hash function that processes a word at a time */
+static size_t checksum_block(const char *const data, const size_t size) {
+    size_t i, word, checksum = (size_t)2166136261UL;
+    for (i = 0; i + sizeof(size_t) <= size; i += sizeof(size_t)) {
+        memcpy(&word, &data[i], sizeof(size_t));
+        checksum = (checksum ^ word) * (size_t)16777619UL;
+    }
+    for (; i < size; i++) {
+        checksum = (checksum ^ (unsigned char)data[i]) * (size_t)16777619UL;
+    }
+    return checksum;
+}
+
+static void compiled_header_init(struct Ini_Compiled_Header *const header, const struct Ini_Snapshot *const snapshot) {
+    memset(header, 0, sizeof(struct Ini_Compiled_Header));
+    memcpy(header->magic, INI_COMPILED_MAGIC, sizeof(INI_COMPILED_MAGIC));
+    header->version = INI_COMPILED_VERSION;
+    header->word_size = sizeof(size_t);
+    header->byte_order = INI_COMPILED_BYTE_ORDER;
+    header->checksum = checksum_block((const char *)snapshot, snapshot->size);
+}
+
+/* Block of memory written by write_file_atomically */
+struct Ini_Output_Range {
+    const char *data;
+    size_t size;
+};
+
+static Ini_File_Error write_file_atomically(const char *filename, const struct Ini_Output_Range *const ranges, const size_t ranges_size);
+
+/* The image is replaced atomically, so the readers never map a truncated image */
+Ini_File_Error ini_file_compile(const struct Ini_File *const ini_file, const char *const filename) {
+    Ini_File_Error error;
+    struct Ini_Compiled_Header header;
+    struct Ini_Output_Range ranges[2];
+    struct Ini_Snapshot *snapshot;
+    if ((ini_file == NULL) || (filename == NULL)) {
+        return ini_invalid_parameters;
+    }
+    snapshot = ini_file_freeze(ini_file);
+    if (snapshot == NULL) {
+        return ini_allocation;
+    }
+    compiled_header_init(&header, snapshot);
+    ranges[0].data = (const char *)&header;
+    ranges[0].size = sizeof(struct Ini_Compiled_Header);
+    ranges[1].data = (const char *)snapshot;
+    ranges[1].size = snapshot->size;
+    error = write_file_atomically(filename, ranges, 2);
+    ini_snapshot_free(snapshot);
+    return error;
+}
+
+/* Checks that the string is stored after the tables and null-terminated inside the block */
+static int snapshot_string_is_valid(const struct Ini_Snapshot *const snapshot, const size_t tables_size, const size_t offset, const size_t len) {
+    return ((offset >= tables_size) && (offset < snapshot->size) && (len < snapshot->size - offset) &&
+        (snapshot_string(snapshot, offset)[len] == '\0'));
+}
+
+/* Checks that the entries of the hash table reference elements of the array, and that it
+ * has an empty slot, where the searches of the missing strings stop */
+static int snapshot_index_is_valid(const size_t *const table, const size_t capacity, const size_t size) {
+    size_t i, empty = 0;
+    for (i = 0; i < capacity; i++) {
+        if (table[i] > size) {
+            return 0;
+        }
+        empty += (table[i] == 0);
+    }
+    return (capacity == 0) || (empty > 0);
+}
+
+/* Checks that the tables of the snapshot, the strings and the entries of the hash tables
+ * are inside the block, so a damaged image can't lead to accesses outside of it. */
+static int snapshot_is_valid(const struct Ini_Snapshot *const snapshot, const size_t size) {
+    const struct Ini_Snapshot_Section *const sections = snapshot_sections(snapshot);
+    const struct Ini_Snapshot_Property *properties;
+    size_t i, tables_size = sizeof(struct Ini_Snapshot);
+    if ((size < sizeof(struct Ini_Snapshot)) || (snapshot->size != size) || (snapshot->sections_size == 0) ||
+        (snapshot->sections_size > size / sizeof(struct Ini_Snapshot_Section)) ||
+        (snapshot->properties_size > size / sizeof(struct Ini_Snapshot_Property)) ||
+        (snapshot->sections_index_capacity > size / sizeof(size_t)) ||
+        (snapshot->properties_index_capacity > size / sizeof(size_t)) ||
+        ((snapshot->sections_index_capacity & (snapshot->sections_index_capacity - 1)) != 0) ||
+        ((snapshot->properties_index_capacity & (snapshot->properties_index_capacity - 1)) != 0)) {
+        return 0;
+    }
+    tables_size += snapshot->sections_size * sizeof(struct Ini_Snapshot_Section) +
+        snapshot->properties_size * sizeof(struct Ini_Snapshot_Property) +
+        (snapshot->sections_index_capacity + snapshot->properties_index_capacity) * sizeof(size_t);
+    if (tables_size > size) {
+        return 0;
+    }
+    for (i = 0; i < snapshot->sections_size; i++) {
+        if ((sections[i].properties > snapshot->properties_size) ||
+            (sections[i].properties_size > snapshot->properties_size - sections[i].properties) ||
+            !snapshot_string_is_valid(snapshot, tables_size, sections[i].name, sections[i].name_len)) {
+            return 0;
+        }
+    }
+    properties = snapshot_properties(snapshot);
+    for (i = 0; i < snapshot->properties_size; i++) {
+        if (!snapshot_string_is_valid(snapshot, tables_size, properties[i].key, properties[i].key_len) ||
+            !snapshot_string_is_valid(snapshot, tables_size, properties[i].value, properties[i].value_len)) {
+            return 0;
+        }
+    }
+    return (snapshot_index_is_valid(snapshot_sections_index(snapshot), snapshot->sections_index_capacity, snapshot->sections_size) &&
+        snapshot_index_is_valid(snapshot_properties_index(snapshot), snapshot->properties_index_capacity, snapshot->properties_size));
+}
+
+static int compiled_image_is_valid(const char *const data, const size_t size) {
+    struct Ini_Compiled_Header header;
+    if (size < sizeof(struct Ini_Compiled_Header)) {
+        return 0;
+    }
+    memcpy(&header, data, sizeof(struct Ini_Compiled_Header));
+    return ((memcmp(header.magic, INI_COMPILED_MAGIC, sizeof(INI_COMPILED_MAGIC)) == 0) &&
+        (header.version == INI_COMPILED_VERSION) && (header.word_size == sizeof(size_t)) &&
+        (header.byte_order == INI_COMPILED_BYTE_ORDER) &&
+        (header.checksum == checksum_block(data + sizeof(struct Ini_Compiled_Header), size - sizeof(struct Ini_Compiled_Header))) &&
+        snapshot_is_valid((const struct Ini_Snapshot *)(data + sizeof(struct Ini_Compiled_Header)), size - sizeof(struct Ini_Compiled_Header)));
+}
+
+Ini_File_Error ini_file_open_compiled(const char *const filename, const struct Ini_Snapshot **const snapshot) {
+    Ini_File_Error error;
+    char *data;
+    size_t size;
+    if ((filename == NULL) || (snapshot == NULL)) {
+        return ini_invalid_parameters;
+    }
+    error = map_file(filename, &data, &size);
+    if (error != ini_no_error) {
+        return error;
+    }
+    if (!compiled_image_is_valid(data, size)) {
+        unmap_file(data, size);
+        return ini_invalid_compiled_image;
+    }
+    *snapshot = (const struct Ini_Snapshot *)(data + sizeof(struct Ini_Compiled_Header));
+    return ini_no_error;
+}
+
+void ini_compiled_close(const struct Ini_Snapshot *const snapshot) {
+    if (snapshot != NULL) {
+        unmap_file((char *)snapshot - sizeof(struct Ini_Compiled_Header), snapshot->size + sizeof(struct Ini_Compiled_Header));
+    }
+}
+
+#if defined(USE_POSIX_SYSTEM_CALLS) && defined(USE_ATOMIC_OPERATIONS)
+/* The shared memory segments are named after the name provided by the user. The control
+ * segment (name) stores the generation of the latest version published, which is stored
+ * in the data segment name.generation, in the same format as the compiled images. */
+#define SHARED_MAGIC "INI-SHM"
+#define MAX_GENERATION_DIGITS 32
+
+struct Ini_Shared_Control {
+    char magic[8];
+    size_t generation;
+};
+
+struct Ini_Shared {
+    char *name;
+    size_t name_len;
+    /* Buffer used to build the names of the data segments */
+    char *segment_name;
+    struct Ini_Shared_Control *control;
+    size_t generation;
+    char *data;
+    size_t size;
+};
+
+/* Writes the name of the data segment of the generation to the buffer */
+static void shared_segment_name(char *const buffer, const char *const name, const size_t name_len, const size_t generation) {
+    memcpy(buffer, name, name_len);
+    sprintf(&buffer[name_len], ".%lu", (unsigned long)generation);
+}
+
+/* Permissions of the segments created by ini_file_publish, which are only accessible by the
+ * user that published them */
+#define SHARED_DEFAULT_MODE 0600
+
+/* Maps the control segment, which is only writable by the publisher (create). The readers
+ * map it read-only, so they don't need the permission to write it. The publisher sets the
+ * permissions of the segment, even if it already exists. */
+static struct Ini_Shared_Control *shared_map_control(const char *const name, const int create, const mode_t mode) {
+    struct Ini_Shared_Control *control;
+    struct stat status;
+    void *mapping;
+    const int fd = shm_open(name, create ? (O_RDWR | O_CREAT) : O_RDONLY, mode);
+    if (fd < 0) {
+        return NULL;
+    }
+    if ((fstat(fd, &status) != 0) || (create && (fchmod(fd, mode) != 0)) ||
+        (((size_t)status.st_size < sizeof(struct Ini_Shared_Control)) &&
+        (!create || (ftruncate(fd, (off_t)sizeof(struct Ini_Shared_Control)) != 0)))) {
+        close(fd);
+        return NULL;
+    }
+    mapping = mmap(NULL, sizeof(struct Ini_Shared_Control), create ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    control = mapping;
+    /* A new control segment is filled with zeros, and the generation zero has no data */
+    if (create && (atomic_load(&control->generation) == 0)) {
+        memcpy(control->magic, SHARED_MAGIC, sizeof(SHARED_MAGIC));
+    }
+    return control;
+}
+
+static Ini_File_Error shared_write_segment(const char *const segment_name, const struct Ini_Snapshot *const snapshot, const mode_t mode) {
+    struct Ini_Compiled_Header header;
+    const size_t size = sizeof(struct Ini_Compiled_Header) + snapshot->size;
+    void *mapping;
+    int fd = shm_open(segment_name, O_RDWR | O_CREAT | O_EXCL, mode);
+    if (fd < 0) {
+        /* Left behind by a publisher that didn't finish */
+        shm_unlink(segment_name);
+        fd = shm_open(segment_name, O_RDWR | O_CREAT | O_EXCL, mode);
+        if (fd < 0) {
+            return ini_couldnt_open_file;
+        }
+    }
+    /* The permissions of shm_open are restricted by the umask */
+    if ((fchmod(fd, mode) != 0) || (ftruncate(fd, (off_t)size) != 0)) {
+        close(fd);
+        shm_unlink(segment_name);
+        return ini_allocation;
+    }
+    mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(segment_name);
+        return ini_allocation;
+    }
+    compiled_header_init(&header, snapshot);
+    memcpy(mapping, &header, sizeof(struct Ini_Compiled_Header));
+    memcpy((char *)mapping + sizeof(struct Ini_Compiled_Header), snapshot, snapshot->size);
+    munmap(mapping, size);
+    return ini_no_error;
+}
+
+Ini_File_Error ini_file_publish_with_mode(const struct Ini_File *const ini_file, const char *const name, const unsigned int mode) {
+    struct Ini_Shared_Control *control;
+    struct Ini_Snapshot *snapshot;
+    Ini_File_Error error;
+    size_t generation;
+    const size_t name_len = (name != NULL) ? strlen(name) : 0;
+    char *segment_name;
+    if ((ini_file == NULL) || (name_len == 0)) {
+        return ini_invalid_parameters;
+    }
+    snapshot = ini_file_freeze(ini_file);
+    segment_name = malloc(name_len + MAX_GENERATION_DIGITS);
+    control = shared_map_control(name, 1, (mode_t)mode);
+    if ((snapshot == NULL) || (segment_name == NULL) || (control == NULL)) {
+        error = (control == NULL) ? ini_couldnt_open_file : ini_allocation;
+        goto ini_file_publish_end;
+    }
+    generation = atomic_load(&control->generation) + 1;
+    shared_segment_name(segment_name, name, name_len, generation);
+    error = shared_write_segment(segment_name, snapshot, (mode_t)mode);
+    if (error != ini_no_error) {
+        goto ini_file_publish_end;
+    }
+    /* The readers attached to the previous generation keep their mappings, which are
+     * released by the system when the last of them is unmapped */
+    atomic_store(&control->generation, generation);
+    if (generation > 1) {
+        shared_segment_name(segment_name, name, name_len, generation - 1);
+        shm_unlink(segment_name);
+    }
+ini_file_publish_end:
+    if (control != NULL) {
+        munmap(control, sizeof(struct Ini_Shared_Control));
+    }
+    free(segment_name);
+    ini_snapshot_free(snapshot);
+    return error;
+}
+
+Ini_File_Error ini_file_publish(const struct Ini_File *const ini_file, const char *const name) {
+    return ini_file_publish_with_mode(ini_file, name, SHARED_DEFAULT_MODE);
+}
+
+Ini_File_Error ini_shared_unlink(const char *const name) {
+    struct Ini_Shared_Control *control;
+    char *segment_name;
+    size_t name_len;
+    if (name == NULL) {
+        return ini_invalid_parameters;
+    }
+    control = shared_map_control(name, 0, 0);
+    if (control == NULL) {
+        return ini_couldnt_open_file;
+    }
+    name_len = strlen(name);
+    segment_name = malloc(name_len + MAX_GENERATION_DIGITS);
+    if (segment_name != NULL) {
+        shared_segment_name(segment_name, name, name_len, atomic_load(&control->generation));
+        shm_unlink(segment_name);
+        free(segment_name);
+    }
+    munmap(control, sizeof(struct Ini_Shared_Control));
+    shm_unlink(name);
+    return (segment_name != NULL) ? ini_no_error : ini_allocation;
+}
+
+/* Maps the data segment of the latest generation. If it was replaced in the meantime,
+ * the new generation is tried. */
+static Ini_File_Error shared_map_data(struct Ini_Shared *const shared) {
+    struct stat status;
+    void *mapping;
+    int fd;
+    for (;;) {
+        const size_t generation = atomic_load(&shared->control->generation);
+        if (generation == 0) {
+            return ini_couldnt_open_file;
+        }
+        shared_segment_name(shared->segment_name, shared->name, shared->name_len, generation);
+        fd = shm_open(shared->segment_name, O_RDONLY, 0);
+        if (fd >= 0) {
+            if (fstat(fd, &status) != 0) {
+                close(fd);
+                return ini_couldnt_open_file;
+            }
+            mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED) {
+                return ini_allocation;
+            }
+            if (!compiled_image_is_valid(mapping, (size_t)status.st_size)) {
+                munmap(mapping, (size_t)status.st_size);
+                return ini_invalid_compiled_image;
+            }
+            shared->data = mapping;
+            shared->size = (size_t)status.st_size;
+            shared->generation = generation;
+            return ini_no_error;
+        }
+        if (atomic_load(&shared->control->generation) == generation) {
+            return ini_couldnt_open_file;
+        }
+    }
+}
+
+struct Ini_Shared *ini_shared_attach(const char *const name) {
+    struct Ini_Shared *shared;
+    size_t name_len;
+    if (name == NULL) {
+        return NULL;
+    }
+    name_len = strlen(name);
+    shared = malloc(sizeof(struct Ini_Shared));
+    if (shared == NULL) {
+        return NULL;
+    }
+    memset(shared, 0, sizeof(struct Ini_Shared));
+    shared->name_len = name_len;
+    shared->name = malloc(name_len + 1);
+    shared->segment_name = malloc(name_len + MAX_GENERATION_DIGITS);
+    shared->control = shared_map_control(name, 0, 0);
+    if ((shared->name == NULL) || (shared->segment_name == NULL) || (shared->control == NULL) ||
+        (memcmp(shared->control->magic, SHARED_MAGIC, sizeof(SHARED_MAGIC)) != 0)) {
+        ini_shared_detach(shared);
+        return NULL;
+    }
+    strcpy(shared->name, name);
+    if (shared_map_data(shared) != ini_no_error) {
+        ini_shared_detach(shared);
+        return NULL;
+    }
+    return shared;
+}
+
+void ini_shared_detach(struct Ini_Shared *const shared) {
+    if (shared == NULL) {
+        return;
+    }
+    if (shared->data != NULL) {
+        munmap(shared->data, shared->size);
+    }
+    if (shared->control != NULL) {
+        munmap(shared->control, sizeof(struct Ini_Shared_Control));
+    }
+    free(shared->name);
+    free(shared->segment_name);
+    free(shared);
+}
+
+const struct Ini_Snapshot *ini_shared_snapshot(const struct Ini_Shared *const shared) {
+    if (shared == NULL) {
+        return NULL;
+    }
+    return (const struct Ini_Snapshot *)(shared->data + sizeof(struct Ini_Compiled_Header));
+}
+
+Ini_File_Error ini_shared_refresh(struct Ini_Shared *const shared) {
+    char *const data = (shared != NULL) ? shared->data : NULL;
+    const size_t size = (shared != NULL) ? shared->size : 0;
+    Ini_File_Error error;
+    if (shared == NULL) {
+        return ini_invalid_parameters;
+    }
+    if (atomic_load(&shared->control->generation) == shared->generation) {
+        return ini_no_error;
+    }
+    error = shared_map_data(shared);
+    if (error != ini_no_error) {
+        /* The current version is kept */
+        return error;
+    }
+    munmap(data, size);
+    return ini_no_error;
+}
+#endif  /* USE_POSIX_SYSTEM_CALLS && USE_ATOMIC_OPERATIONS */
+
+Ini_File_Error ini_file_add_section_sized(struct Ini_File *const ini_file, const char *const name, const size_t name_len) {
+    size_t section_index;
+    char *copied_name;
+    if (ini_file == NULL) {
+        return ini_invalid_parameters;
+    }
+    if ((name == NULL) || (name_len == 0)) {
+        return ini_section_not_provided;
+    }
+    if (ini_file->flags & ini_bulk_load) {
+        /* The repeated sections are merged at the end of the bulk load */
+        section_index = ini_file->sections_size;
+    } else if (ini_file_find_section_index(ini_file, name, name_len, &section_index) == ini_no_error) {
+        /* There is already a section with that name so we just update the current section */
+        ini_file->current_section = &ini_file->sections[section_index];
+        return ini_no_error;
+    }
+    /* Check if we need expand the array of sections */
+    ini_file_array_resize(ini_file, ini_file->sections, INITIAL_SECTIONS_CAPACITY);
+    /* Allocates memory to store the section name */
+    copied_name = store_sized_string(ini_file, name, name_len);
+    if (copied_name == NULL) {
+        return ini_allocation;
+    }
+    /* Updates the current section */
+    ini_file->current_section = &ini_file->sections[section_index];
+    /* Moves the sections to insert the new section in the middle, keeping the array sorted by names */
+    memmove((ini_file->current_section + 1), ini_file->current_section, (ini_file->sections_size - section_index)*sizeof(struct Ini_Section));
+    ini_file->bytes_moved += (ini_file->sections_size - section_index)*sizeof(struct Ini_Section);
+    memset(ini_file->current_section, 0, sizeof(struct Ini_Section));
+    ini_file->current_section->name = copied_name;
+    ini_file->current_section->name_len = name_len;
+    ini_file->sections_size++;
+    if ((ini_file->flags & ini_hash_index) && !(ini_file->flags & ini_bulk_load)) {
+        section_index_insert(ini_file, &ini_file->sections_index, &ini_file->sections_index_capacity, ini_file->sections, ini_file->sections_size, section_index);
+    }
+    return ini_no_error;
+}
+
+Ini_File_Error ini_file_add_section(struct Ini_File *const ini_file, const char *const name) {
+    if (name == NULL) {
+        return ini_section_not_provided;
+    }
+    return ini_file_add_section_sized(ini_file, name, strlen(name));
+}
+
+static Ini_File_Error ini_file_insert_property(struct Ini_File *const ini_file, const char *const key, const size_t key_len, const char *const value, const size_t value_len, const size_t line_number, const size_t value_offset) {
+    size_t property_index, cached_capacity;
+    struct Key_Value_Pair *property;
+    char *copied_key, *copied_value;
+    if (ini_file == NULL) {
+        return ini_invalid_parameters;
+    }
+    if ((key == NULL) || (key_len == 0)) {
+        return ini_key_not_provided;
+    }
+    if ((value == NULL) || (value_len == 0)) {
+        return ini_value_not_provided;
+    }
+    cached_capacity = ini_file->current_section->properties_capacity;
+    if (ini_file->flags & ini_bulk_load) {
+        /* The repeated keys are detected at the end of the bulk load */
+        property_index = ini_file->current_section->properties_size;
+    } else if (ini_file_find_key_index(ini_file->current_section, key, key_len, &property_index) == ini_no_error) {
+        /* There is already a property with that key name, which is not allowed */
+        return ini_repeated_key;
+    }
+    /* Check if we need expand the array of properties */
+    ini_file_array_resize(ini_file, ini_file->current_section->properties, INITIAL_PROPERTIES_CAPACITY);
+    if (ini_file->flags & ini_bulk_load) {
+        /* The properties are sorted at the end of the bulk load, when the cache is allocated */
+        ini_section_release_cache(ini_file, ini_file->current_section);
+    } else {
+        ini_section_reserve_cache(ini_file, ini_file->current_section, cached_capacity);
+    }
+    copied_key = store_sized_string(ini_file, key, key_len);
+    if (copied_key == NULL) {
+        return ini_allocation;
+    }
+    copied_value = store_sized_string(ini_file, value, value_len);
+    if (copied_value == NULL) {
+        free_string(ini_file, copied_key, key_len);
+        return ini_allocation;
+    }
+    property = &ini_file->current_section->properties[property_index];
+    /* Moves the properties to insert the new property in the middle, keeping the array sorted by keys */
+    memmove((property + 1), property, (ini_file->current_section->properties_size - property_index)*sizeof(struct Key_Value_Pair));
+    ini_file->bytes_moved += (ini_file->current_section->properties_size - property_index)*sizeof(struct Key_Value_Pair);
+    if (ini_file->current_section->cached_values != NULL) {
+        struct Ini_Cached_Value *const cached = &ini_file->current_section->cached_values[property_index];
+        memmove((cached + 1), cached, (ini_file->current_section->properties_size - property_index)*sizeof(struct Ini_Cached_Value));
+        memset(cached, 0, sizeof(struct Ini_Cached_Value));
+    }
+    /* Update the values to the new property */
+    property->key = copied_key;
+    property->value = copied_value;
+    property->key_len = key_len;
+    property->value_len = value_len;
+    property->line_number = line_number;
+    property->value_offset = value_offset;
+    ini_file->current_section->properties_size++;
+    /* The properties were moved, so the handles are no longer valid */
+    ini_file->version = 0;
+    if ((ini_file->flags & ini_hash_index) && !(ini_file->flags & ini_bulk_load)) {
+        property_index_insert(ini_file, &ini_file->current_section->properties_index, &ini_file->current_section->properties_index_capacity, ini_file->current_section->properties, ini_file->current_section->properties_size, property_index);
+    }
+    return ini_no_error;
+}
+
+Ini_File_Error ini_file_add_property_sized(struct Ini_File *const ini_file, const char *const key, const size_t key_len, const char *const value, const size_t value_len) {
+    return ini_file_insert_property(ini_file, key, key_len, value, value_len, 0, 0);
+}
+
+Ini_File_Error ini_file_add_property(struct Ini_File *const ini_file, const char *const key, const char *const value) {
+    if (key == NULL) {
+        return ini_key_not_provided;
+    }
+    if (value == NULL) {
+        return ini_value_not_provided;
+    }
+    return ini_file_add_property_sized(ini_file, key, strlen(key), value, strlen(value));
+}
+
+/* Finds the section by its name, where NULL or an empty name selects the global section */
+static Ini_File_Error ini_file_lookup_section_by_name(struct Ini_File *const ini_file, const char *const section, size_t *const section_index, struct Ini_Section **const ini_section) {
+    Ini_File_Error error;
+    if ((section == NULL) || (section[0] == '\0')) {
+        *ini_section = &ini_file->global_section;
+        return ini_no_error;
+    }
+    error = ini_file_lookup_section(ini_file, section, strlen(section), section_index);
+    if (error == ini_no_error) {
+        *ini_section = &ini_file->sections[*section_index];
+    }
+    return error;
+}
+
+Ini_File_Error ini_file_set_property(struct Ini_File *const ini_file, const char *const section, const char *const key, const char *const value) {
+    struct Ini_Section *ini_section, *current_section;
+    struct Key_Value_Pair *property;
+    size_t section_index, current_index = 0, value_len;
+    Ini_File_Error error;
+    char *copied_value;
+    /* In the zero-copy mode the new value would reference the memory of the caller */
+    if ((ini_file == NULL) || (ini_file->flags & (ini_bulk_load | ini_zero_copy))) {
+        return ini_invalid_parameters;
+    }
+    if ((key == NULL) || (key[0] == '\0')) {
+        return ini_key_not_provided;
+    }
+    if ((value == NULL) || (value[0] == '\0')) {
+        return ini_value_not_provided;
+    }
+    value_len = strlen(value);
+    if ((ini_file_find_section(ini_file, section, &ini_section) == ini_no_error) &&
+        (ini_section_find_pair(ini_section, key, &property) == ini_no_error)) {
+        copied_value = store_sized_string(ini_file, value, value_len);
+        if (copied_value == NULL) {
+            return ini_allocation;
+        }
+        free_string(ini_file, property->value, property->value_len);
+        property->value = copied_value;
+        property->value_len = value_len;
+        if (ini_section->cached_values != NULL) {
+            ini_section->cached_values[property - ini_section->properties].cached_type = cached_none;
+        }
+        return ini_no_error;
+    }
+    /* The new property is inserted by ini_file_insert_property in the current section, which
+     * is restored afterwards. The insertion of a section moves the following ones. */
+    current_section = ini_file->current_section;
+    if (current_section != &ini_file->global_section) {
+        current_index = (size_t)(current_section - ini_file->sections);
+    }
+    if (ini_file_lookup_section_by_name(ini_file, section, &section_index, &ini_section) != ini_no_error) {
+        error = ini_file_add_section(ini_file, section);
+        if (error != ini_no_error) {
+            return error;
+        }
+        section_index = (size_t)(ini_file->current_section - ini_file->sections);
+        if ((current_section != &ini_file->global_section) && (current_index >= section_index)) {
+            current_index++;
+        }
+    }
+    ini_file->current_section = ((section == NULL) || (section[0] == '\0')) ? &ini_file->global_section : &ini_file->sections[section_index];
+    error = ini_file_insert_property(ini_file, key, strlen(key), value, value_len, 0, 0);
+    ini_file->current_section = (current_section == &ini_file->global_section) ? current_section : &ini_file->sections[current_index];
+    return error;
+}
+
+Ini_File_Error ini_file_remove_property(struct Ini_File *const ini_file, const char *const section, const char *const key) {
+    struct Ini_Section *ini_section;
+    size_t section_index, property_index;
+    Ini_File_Error error;
+    if ((ini_file == NULL) || (key == NULL) || (key[0] == '\0') || (ini_file->flags & ini_bulk_load)) {
+        return ini_invalid_parameters;
+    }
+    error = ini_file_lookup_section_by_name(ini_file, section, &section_index, &ini_section);
+    if (error != ini_no_error) {
+        return error;
+    }
+    error = ini_section_lookup_key(ini_section, key, strlen(key), &property_index);
+    if (error != ini_no_error) {
+        return error;
+    }
+    free_string(ini_file, ini_section->properties[property_index].key, ini_section->properties[property_index].key_len);
+    free_string(ini_file, ini_section->properties[property_index].value, ini_section->properties[property_index].value_len);
+    ini_section->properties_size--;
+    ini_file->version = 0;
+    memmove(&ini_section->properties[property_index], &ini_section->properties[property_index + 1], (ini_section->properties_size - property_index)*sizeof(struct Key_Value_Pair));
+    if (ini_section->cached_values != NULL) {
+        memmove(&ini_section->cached_values[property_index], &ini_section->cached_values[property_index + 1], (ini_section->properties_size - property_index)*sizeof(struct Ini_Cached_Value));
+    }
+    ini_file->bytes_moved += (ini_section->properties_size - property_index)*sizeof(struct Key_Value_Pair);
+    property_index_remove(ini_file, &ini_section->properties_index, &ini_section->properties_index_capacity, ini_section->properties, ini_section->properties_size);
+    return ini_no_error;
+}
+
+Ini_File_Error ini_file_remove_section(struct Ini_File *const ini_file, const char *const section) {
+    struct Ini_Section *ini_section;
+    size_t section_index;
+    Ini_File_Error error;
+    if ((ini_file == NULL) || (ini_file->flags & ini_bulk_load)) {
+        return ini_invalid_parameters;
+    }
+    error = ini_file_lookup_section_by_name(ini_file, section, &section_index, &ini_section);
+    if (error != ini_no_error) {
+        return error;
+    }
+    ini_section_free_strings(ini_file, ini_section);
+    ini_section_release_cache(ini_file, ini_section);
+    ini_file->version = 0;
+    if (ini_section == &ini_file->global_section) {
+        /* The global section always exists, so only its properties are removed */
+        ini_section->properties_size = 0;
+        ini_release(ini_file, ini_section->properties_index);
+        ini_section->properties_index = NULL;
+        ini_section->properties_index_capacity = 0;
+        return ini_no_error;
+    }
+    ini_release(ini_file, ini_section->properties);
+    ini_release(ini_file, ini_section->properties_index);
+    if (ini_file->current_section == ini_section) {
+        ini_file->current_section = &ini_file->global_section;
+    } else if (ini_file->current_section > ini_section) {
+        ini_file->current_section--;
+    }
+    ini_file->sections_size--;
+    memmove(ini_section, ini_section + 1, (ini_file->sections_size - section_index)*sizeof(struct Ini_Section));
+    ini_file->bytes_moved += (ini_file->sections_size - section_index)*sizeof(struct Ini_Section);
+    section_index_remove(ini_file, &ini_file->sections_index, &ini_file->sections_index_capacity, ini_file->sections, ini_file->sections_size);
+    return ini_no_error;
+}
+
+/* Stable merge sort, used to sort the arrays only once at the end of the bulk load.
+ * The temporary buffer must have room for count elements. */
+#define merge_sort_function(function_name, type, compare) \
+    static void function_name(type *const array, type *const tmp, const size_t count) { \
+        type *src = array, *dst = tmp, *swap; \
+        size_t width, i; \
+        /* Most of the time the INI files are already sorted */ \
+        i = 1; \
+        while ((i < count) && (compare(&array[i - 1], &array[i]) <= 0)) { \
+            i++; \
+        } \
+        if (i >= count) { \
+            return; \
+        } \
+        for (width = 1; width < count; width *= 2) { \
+            for (i = 0; i < count; i += 2 * width) { \
+                const size_t middle = (i + width < count) ? (i + width) : count; \
+                const size_t end = (i + 2 * width < count) ? (i + 2 * width) : count; \
+                size_t left = i, right = middle, k = i; \
+                while ((left < middle) && (right < end)) { \
+                    /* Takes the left element when they are equal, so the sort is stable */ \
+                    dst[k++] = (compare(&src[right], &src[left]) < 0) ? src[right++] : src[left++]; \
+                } \
+                while (left < middle) { \
+                    dst[k++] = src[left++]; \
+                } \
+                while (right < end) { \
+                    dst[k++] = src[right++]; \
+                } \
+            } \
+            swap = src; \
+            src = dst; \
+            dst = swap; \
+        } \
+        if (src != array) { \
+            memcpy(array, src, count * sizeof(type)); \
+        } \
+    }
+
+static int compare_sections(const struct Ini_Section *const a, const struct Ini_Section *const b) {
+    return compare_sized_strings(a->name, a->name_len, b->name, b->name_len);
+}
+
+static int compare_properties(const struct Key_Value_Pair *const a, const struct Key_Value_Pair *const b) {
+    return compare_sized_strings(a->key, a->key_len, b->key, b->key_len);
+}
+
+merge_sort_function(sort_sections, struct Ini_Section, compare_sections)
+merge_sort_function(sort_properties, struct Key_Value_Pair, compare_properties)
+
+static int compare_line_numbers(const struct Key_Value_Pair *const a, const struct Key_Value_Pair *const b) {
+    return (a->line_number > b->line_number) - (a->line_number < b->line_number);
+}
+
+merge_sort_function(sort_repeated_keys, struct Key_Value_Pair, compare_line_numbers)
+
+/* Stores the first event of a property found by the tokenizer */
+static int ini_capture_property(const struct Ini_Event *const event, void *const user_data) {
+    if (event->type != ini_event_property) {
+        return 0;
+    }
+    *(struct Ini_Event *)user_data = *event;
+    return 1;
+}
+
+/* Finds the line that contains the byte at offset of the input, whose part stored at data
+ * starts at the byte window_start. Returns zero if the line may start before this part. */
+static int find_line_at(const char *const data, const size_t size, const size_t window_start, const size_t offset, const char **const line, const char **const line_end) {
+    const char *start = data + (offset - window_start), *end;
+    while ((start > data) && (start[-1] != '\n')) {
+        start--;
+    }
+    if ((start == data) && (window_start > 0)) {
+        return 0;
+    }
+    end = memchr(start, '\n', size - (size_t)(start - data));
+    *line = start;
+    *line_end = (end != NULL) ? (end + 1) : (data + size);
+    return 1;
+}
+
+/* Reports a repeated key found at the end of the bulk load, with the line in which it was
+ * declared, which is tokenized again to report the same column of the other errors. Only
+ * MAX_LINE_SIZE bytes around the value are read from the file, so the columns of longer
+ * lines may differ. If the line isn't available (e.g. the properties added by the
+ * ini_file_add_* functions), the key is presented instead, in the column zero. */
+static int ini_file_report_repeated_key(const struct Ini_File *const ini_file, const struct Key_Value_Pair *const property, const struct Ini_Line_Source *const source, FILE *const file, char *const window, const char *const filename, Ini_File_Error_Callback callback) {
+    struct Ini_Event event;
+    const char *line, *line_end;
+    int found = 0;
+    event.type = ini_event_comment;
+    if ((property->line_number > 0) && (source->data != NULL) && (property->value_offset <= source->size)) {
+        found = find_line_at(source->data, source->size, 0, property->value_offset, &line, &line_end);
+    } else if ((property->line_number > 0) && (file != NULL)) {
+        const size_t window_start = (property->value_offset > MAX_LINE_SIZE) ? (property->value_offset - MAX_LINE_SIZE) : 0;
+        size_t size;
+        if (fseek(file, (long)window_start, SEEK_SET) == 0) {
+            size = fread(window, 1, 2 * MAX_LINE_SIZE, file);
+            found = (property->value_offset - window_start <= size) &&
+                find_line_at(window, size, window_start, property->value_offset, &line, &line_end);
+        }
+    }
+    if (found) {
+        ini_tokenize_line(line, line_end, property->line_number, 0, ini_capture_property, &event);
+    }
+    if (event.type != ini_event_property) {
+        return report_line(&ini_file->allocator, callback, filename, property->line_number, 0, property->key, property->key_len, ini_repeated_key);
+    }
+    return ini_file_report_error(&ini_file->allocator, callback, filename, &event, ini_repeated_key);
+}
+
+/* Reports the repeated keys discarded by the bulk load, sorted by their line numbers, and
+ * releases their strings. The sort uses the second half of the array. */
+static void ini_file_report_repeated_keys(struct Ini_File *const ini_file, struct Key_Value_Pair *const repeated, const size_t repeated_size, const struct Ini_Line_Source *const source, const char *const filename, Ini_File_Error_Callback callback, int *const aborted) {
+    FILE *file = NULL;
+    char *window = NULL;
+    size_t i;
+    if ((callback != NULL) && !*aborted && (repeated_size > 0)) {
+        sort_repeated_keys(repeated, &repeated[repeated_size], repeated_size);
+        window = ini_allocate(ini_file, 2 * MAX_LINE_SIZE);
+        if ((window != NULL) && (source->data == NULL) && (source->filename != NULL)) {
+            file = fopen(source->filename, "rb");
+        }
+    }
+    for (i = 0; i < repeated_size; i++) {
+        if ((window != NULL) && !*aborted) {
+            *aborted = ini_file_report_repeated_key(ini_file, &repeated[i], source, file, window, filename, callback);
+        }
+        free_string(ini_file, repeated[i].key, repeated[i].key_len);
+        free_string(ini_file, repeated[i].value, repeated[i].value_len);
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+    ini_release(ini_file, window);
+}
+
+/* Counts the properties of the sorted section whose keys are equal to the previous ones */
+static size_t ini_section_count_repeated_keys(const struct Ini_Section *const ini_section) {
+    size_t i, count = 0;
+    for (i = 1; i < ini_section->properties_size; i++) {
+        count += (compare_properties(&ini_section->properties[i - 1], &ini_section->properties[i]) == 0);
+    }
+    return count;
+}
+
+/* Discards the repeated keys of the sorted section, keeping the first one declared. The
+ * repeated ones are moved to the array repeated, if provided, otherwise their strings are
+ * released. */
+static void ini_section_discard_repeated_keys(struct Ini_File *const ini_file, struct Ini_Section *const ini_section, struct Key_Value_Pair *const repeated, size_t *const repeated_size) {
+    size_t i, size = 0;
+    for (i = 0; i < ini_section->properties_size; i++) {
+        struct Key_Value_Pair *const property = &ini_section->properties[i];
+        if ((size > 0) && (compare_properties(&ini_section->properties[size - 1], property) == 0)) {
+            if (repeated != NULL) {
+                repeated[(*repeated_size)++] = *property;
+            } else {
+                free_string(ini_file, property->key, property->key_len);
+                free_string(ini_file, property->value, property->value_len);
+            }
+            continue;
+        }
+        ini_section->properties[size++] = *property;
+    }
+    ini_section->properties_size = size;
+}
+
+/* Sorts the arrays filled during the bulk load. The repeated sections are merged, and the
+ * repeated keys are discarded and reported in the order of their lines. If the callback
+ * returns a value different from zero, the variable aborted is set and the callback is not
+ * called anymore. */
+static Ini_File_Error ini_file_finish_bulk_load(struct Ini_File *const ini_file, const struct Ini_Line_Source *const source, const char *const filename, Ini_File_Error_Callback callback, int *const aborted) {
+    Ini_File_Error error = ini_no_error;
+    struct Key_Value_Pair *repeated;
+    size_t repeated_size = 0;
+    const char *current_name = ini_file->current_section->name;
+    const size_t current_name_len = ini_file->current_section->name_len;
+    size_t i, size, tmp_size = ini_file->global_section.properties_size;
+    void *tmp = ini_allocate(ini_file, ini_file->sections_size * sizeof(struct Ini_Section));
+    if ((tmp == NULL) && (ini_file->sections_size > 0)) {
+        return ini_allocation;
+    }
+    /* The properties are merged and sorted, so the caches of the converted values are released */
+    ini_section_release_cache(ini_file, &ini_file->global_section);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        ini_section_release_cache(ini_file, &ini_file->sections[i]);
+    }
+    sort_sections(ini_file->sections, tmp, ini_file->sections_size);
+    ini_release(ini_file, tmp);
+    /* Merges the repeated sections, which are adjacent after sorting */
+    for (i = 0, size = 0; i < ini_file->sections_size; i++) {
+        struct Ini_Section *const section = &ini_file->sections[i];
+        struct Ini_Section *merged;
+        if ((size == 0) || (compare_sections(&ini_file->sections[size - 1], section) != 0)) {
+            ini_file->sections[size++] = *section;
+            continue;
+        }
+        merged = &ini_file->sections[size - 1];
+        if (section->properties_size > 0) {
+            const size_t new_size = merged->properties_size + section->properties_size;
+            if (new_size >= merged->properties_capacity) {
+                void *const new_array = ini_reallocate(ini_file, merged->properties, (new_size + 1) * sizeof(struct Key_Value_Pair));
+                if (new_array == NULL) {
+                    /* Keeps the remaining sections, so the structure is still valid */
+                    memmove(&ini_file->sections[size], section, (ini_file->sections_size - i) * sizeof(struct Ini_Section));
+                    ini_file->sections_size = size + (ini_file->sections_size - i);
+                    return ini_allocation;
+                }
+                merged->properties = new_array;
+                merged->properties_capacity = new_size + 1;
+            }
+            memcpy(&merged->properties[merged->properties_size], section->properties, section->properties_size * sizeof(struct Key_Value_Pair));
+            merged->properties_size = new_size;
+        }
+        if (current_name == section->name) {
+            current_name = merged->name;
+        }
+        ini_release(ini_file, section->properties);
+        ini_release(ini_file, section->properties_index);
+        free_string(ini_file, section->name, section->name_len);
+    }
+    ini_file->sections_size = size;
+    ini_file->version = 0;
+    /* The temporary buffer used by the merge sort must fit the properties of any section */
+    for (i = 0; i < ini_file->sections_size; i++) {
+        tmp_size = max_size(tmp_size, ini_file->sections[i].properties_size);
+    }
+    tmp = ini_allocate(ini_file, tmp_size * sizeof(struct Key_Value_Pair));
+    if ((tmp == NULL) && (tmp_size > 0)) {
+        return ini_allocation;
+    }
+    ini_file->flags &= ~ini_bulk_load;
+    sort_properties(ini_file->global_section.properties, tmp, ini_file->global_section.properties_size);
+    size = ini_section_count_repeated_keys(&ini_file->global_section);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        sort_properties(ini_file->sections[i].properties, tmp, ini_file->sections[i].properties_size);
+        size += ini_section_count_repeated_keys(&ini_file->sections[i]);
+    }
+    ini_release(ini_file, tmp);
+    /* The repeated keys are sorted by their lines before being reported */
+    repeated = (size > 0) ? ini_allocate(ini_file, 2 * size * sizeof(struct Key_Value_Pair)) : NULL;
+    ini_section_discard_repeated_keys(ini_file, &ini_file->global_section, repeated, &repeated_size);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        ini_section_discard_repeated_keys(ini_file, &ini_file->sections[i], repeated, &repeated_size);
+    }
+    if (size > 0) {
+        error = (repeated != NULL) ? ini_repeated_key : ini_allocation;
+        ini_file_report_repeated_keys(ini_file, repeated, repeated_size, source, filename, callback, aborted);
+        ini_release(ini_file, repeated);
+    }
+    if (ini_file->flags & ini_hash_index) {
+        ini_file_build_index(ini_file);
+    }
+    ini_file_reserve_caches(ini_file);
+    /* The current section is the one which was the current section before sorting */
+    ini_file->current_section = &ini_file->global_section;
+    if ((current_name != NULL) && (ini_file_find_section_index(ini_file, current_name, current_name_len, &i) == ini_no_error)) {
+        ini_file->current_section = &ini_file->sections[i];
+    }
+    return error;
+}
+
+Ini_File_Error ini_file_bulk_begin(struct Ini_File *const ini_file) {
+    if (ini_file == NULL) {
+        return ini_invalid_parameters;
+    }
+    ini_file->flags |= ini_bulk_load;
+    return ini_no_error;
+}
+
+Ini_File_Error ini_file_bulk_end(struct Ini_File *const ini_file, Ini_File_Error_Callback callback) {
+    /* The properties added by the ini_file_add_* functions have no lines */
+    static const struct Ini_Line_Source source = {NULL, 0, NULL};
+    int aborted = 0;
+    if (ini_file == NULL) {
+        return ini_invalid_parameters;
+    }
+    if (!(ini_file->flags & ini_bulk_load)) {
+        return ini_no_error;
+    }
+    return ini_file_finish_bulk_load(ini_file, &source, "<bulk>", callback, &aborted);
+}
+
+/* Queries of ini_file_find_many sorted by section and key. They are sorted in batches of
+ * FIND_MANY_BATCH_SIZE queries in the stack, so no memory is allocated. */
+#define FIND_MANY_BATCH_SIZE 32
+
+struct Ini_Query_Entry {
+    const char *section;
+    size_t section_len;
+    const char *key;
+    size_t key_len;
+    size_t index;
+};
+
+static int compare_query_entries(const struct Ini_Query_Entry *const a, const struct Ini_Query_Entry *const b) {
+    const int comp = compare_sized_strings(a->section, a->section_len, b->section, b->section_len);
+    return (comp != 0) ? comp : compare_sized_strings(a->key, a->key_len, b->key, b->key_len);
+}
+
+merge_sort_function(sort_query_entries, struct Ini_Query_Entry, compare_query_entries)
+
+/* Stores the value of the property at the destination of the query, converted to its type */
+static Ini_File_Error ini_query_store(struct Ini_Query *const query, struct Ini_Section *const ini_section, struct Key_Value_Pair *const property) {
+    struct Ini_Cached_Value *cached;
+    query->property = property;
+    if (query->result == NULL) {
+        return ini_no_error;
+    }
+    /* The strings don't use the cache, so it's not allocated for them */
+    cached = (query->type != ini_value_string) ? ini_section_cached_value(ini_section, property) : NULL;
+    switch (query->type) {
+    case ini_value_string:
+        *(char **)query->result = property->value;
+        return ini_no_error;
+    case ini_value_integer:
+        return property_to_integer(cached, property, (long *)query->result);
+    case ini_value_unsigned:
+        return property_to_unsigned(cached, property, (unsigned long *)query->result);
+    case ini_value_double:
+        return property_to_double(cached, property, (double *)query->result);
+    case ini_value_boolean:
+        return property_to_boolean(cached, property, (int *)query->result);
+    case ini_value_size:
+        return property_to_size(cached, property, (unsigned long *)query->result);
+    case ini_value_duration:
+        return property_to_duration(cached, property, (double *)query->result);
+    }
+    return ini_invalid_parameters;
+}
+
+/* Resolves the queries of the same section, whose keys are sorted, in a single pass over the
+ * sorted properties. Each key is searched after the position of the previous one, so the
+ * properties between them are skipped by a binary search. */
+static void ini_section_find_entries(struct Ini_Section *const ini_section, struct Ini_Query *const queries, const struct Ini_Query_Entry *const entries, const size_t entries_size) {
+    size_t i, cursor = 0;
+    for (i = 0; i < entries_size; i++) {
+        struct Ini_Query *const query = &queries[entries[i].index];
+        if (ini_section == NULL) {
+            query->error = ini_no_such_section;
+            continue;
+        }
+        cursor = property_lower_bound(ini_section->properties, cursor, ini_section->properties_size, entries[i].key, entries[i].key_len, 0);
+        if ((cursor < ini_section->properties_size) &&
+            (compare_sized_strings(ini_section->properties[cursor].key, ini_section->properties[cursor].key_len, entries[i].key, entries[i].key_len) == 0)) {
+            query->error = ini_query_store(query, ini_section, &ini_section->properties[cursor]);
+        } else {
+            query->error = ini_no_such_property;
+        }
+    }
+}
+
+/* Resolves a batch of at most FIND_MANY_BATCH_SIZE queries, starting at the first one */
+static void ini_file_find_batch(struct Ini_File *const ini_file, struct Ini_Query *const queries, const size_t first_query, const size_t queries_size) {
+    /* The second half of the entries is used as the temporary buffer of the sort */
+    struct Ini_Query_Entry entries[2 * FIND_MANY_BATCH_SIZE];
+    struct Ini_Section *ini_section;
+    size_t i, first, size = 0, section_index;
+    for (i = first_query; i < first_query + queries_size; i++) {
+        queries[i].property = NULL;
+        if ((queries[i].key == NULL) || (queries[i].key[0] == '\0')) {
+            queries[i].error = ini_invalid_parameters;
+            continue;
+        }
+        entries[size].section = (queries[i].section != NULL) ? queries[i].section : "";
+        entries[size].section_len = strlen(entries[size].section);
+        entries[size].key = queries[i].key;
+        entries[size].key_len = strlen(queries[i].key);
+        entries[size].index = i;
+        size++;
+    }
+    sort_query_entries(entries, &entries[FIND_MANY_BATCH_SIZE], size);
+    for (first = 0; first < size; first = i) {
+        for (i = first + 1; (i < size) && (compare_sized_strings(entries[i].section, entries[i].section_len, entries[first].section, entries[first].section_len) == 0); i++);
+        if (entries[first].section_len == 0) {
+            ini_section = &ini_file->global_section;
+        } else if (ini_file_lookup_section(ini_file, entries[first].section, entries[first].section_len, &section_index) == ini_no_error) {
+            ini_section = &ini_file->sections[section_index];
+        } else {
+            ini_section = NULL;
+        }
+        ini_section_find_entries(ini_section, queries, &entries[first], i - first);
+    }
+}
+
+Ini_File_Error ini_file_find_many(struct Ini_File *const ini_file, struct Ini_Query *const queries, const size_t queries_size) {
+    size_t i;
+    if ((ini_file == NULL) || ((queries == NULL) && (queries_size > 0)) || (ini_file->flags & ini_bulk_load)) {
+        return ini_invalid_parameters;
+    }
+    for (i = 0; i < queries_size; i += FIND_MANY_BATCH_SIZE) {
+        ini_file_find_batch(ini_file, queries, i, ((queries_size - i) < FIND_MANY_BATCH_SIZE) ? (queries_size - i) : FIND_MANY_BATCH_SIZE);
+    }
+    for (i = 0; i < queries_size; i++) {
+        if (queries[i].error != ini_no_error) {
+            return queries[i].error;
+        }
+    }
+    return ini_no_error;
+}
+
+/* Minimum size of the chunks parsed by each thread of the parallel parser */
+#define MIN_PARALLEL_CHUNK_SIZE 65536
+#define MAX_PARALLEL_THREADS 64
+
+/* Each worker of the parallel parser builds a partial Ini_File from its chunk of the file.
+ * In the copy mode, each one has its own string arena, so no locking is needed. */
+struct Ini_Parse_Worker {
+    const char *data;
+    size_t len;
+    size_t first_line_number;
+    size_t lines;
+    /* Offset of the chunk from the beginning of the file */
+    size_t offset;
+    struct Ini_File *ini_file;
+    struct Ini_Error_Log log;
+    /* Critical error, which aborts the parsing */
+    Ini_File_Error error;
+#ifdef USE_POSIX_THREADS
+    pthread_t thread;
+#endif
+};
+
+static int ini_detect_section(const struct Ini_Event *const event, void *const user_data) {
+    if (event->type == ini_event_section) {
+        *(int *)user_data = 1;
+    }
+    return 1;
+}
+
+/* Finds the first line, starting at the cursor, that declares a section. The chunks must
+ * start at a valid declaration, otherwise the properties would go to the wrong section. */
+static const char *find_section_declaration(const char *cursor, const char *const end) {
+    /* The search starts at the beginning of the next line */
+    if (cursor[-1] != '\n') {
+        cursor = memchr(cursor, '\n', (size_t)(end - cursor));
+        cursor = (cursor == NULL) ? end : (cursor + 1);
+    }
+    while (cursor < end) {
+        int is_section = 0;
+        const char *line_end = memchr(cursor, '\n', (size_t)(end - cursor));
+        line_end = (line_end == NULL) ? end : (line_end + 1);
+        ini_tokenize_line(cursor, line_end, 0, 0, ini_detect_section, &is_section);
+        if (is_section) {
+            return cursor;
+        }
+        cursor = line_end;
+    }
+    return end;
+}
+
+static size_t count_lines(const char *data, const size_t len) {
+    const char *const end = data + len;
+    size_t lines = 0;
+    while ((data = memchr(data, '\n', (size_t)(end - data))) != NULL) {
+        data++;
+        lines++;
+    }
+    return lines;
+}
+
+static void *ini_count_lines_worker(void *const argument) {
+    struct Ini_Parse_Worker *const worker = argument;
+    worker->lines = count_lines(worker->data, worker->len);
+    return NULL;
+}
+
+static void *ini_parse_worker(void *const argument) {
+    struct Ini_Parse_Worker *const worker = argument;
+    struct Ini_File_Builder builder;
+    struct Ini_File *const ini_file = worker->ini_file;
+    struct Key_Value_Pair *tmp;
+    size_t i, tmp_size = ini_file->global_section.properties_size;
+    builder.ini_file = ini_file;
+    builder.filename = NULL;
+    builder.callback = NULL;
+    builder.log = &worker->log;
+    builder.aborted = 0;
+    /* The lines were already counted, but the tokenizer may stop before the end of the chunk */
+    worker->lines = ini_tokenize_lines(worker->data, worker->len, worker->first_line_number, worker->offset, ini_file_handle_event, &builder);
+    if (builder.aborted) {
+        worker->error = ini_allocation;
+        return NULL;
+    }
+    /* The properties are sorted by the workers, so the final sort only needs to merge
+     * the sections repeated in different chunks */
+    for (i = 0; i < ini_file->sections_size; i++) {
+        tmp_size = max_size(tmp_size, ini_file->sections[i].properties_size);
+    }
+    tmp = ini_allocate(ini_file, tmp_size * sizeof(struct Key_Value_Pair));
+    if ((tmp == NULL) && (tmp_size > 0)) {
+        worker->error = ini_allocation;
+        return NULL;
+    }
+    sort_properties(ini_file->global_section.properties, tmp, ini_file->global_section.properties_size);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        sort_properties(ini_file->sections[i].properties, tmp, ini_file->sections[i].properties_size);
+    }
+    ini_release(ini_file, tmp);
+    return NULL;
+}
+
+/* Runs the function for each worker, in parallel if possible */
+static void ini_run_workers(struct Ini_Parse_Worker *const workers, const size_t count, void *(*function)(void *)) {
+    size_t i;
+#ifdef USE_POSIX_THREADS
+    size_t started;
+    /* The first chunk is processed by the calling thread */
+    for (started = 1; started < count; started++) {
+        if (pthread_create(&workers[started].thread, NULL, function, &workers[started]) != 0) {
+            break;
+        }
+    }
+    function(&workers[0]);
+    for (i = 1; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    /* If a thread couldn't be created, the remaining chunks are processed sequentially */
+    for (i = started; i < count; i++) {
+        function(&workers[i]);
+    }
+#else
+    for (i = 0; i < count; i++) {
+        function(&workers[i]);
+    }
+#endif
+}
+
+/* Moves the strings stored by the source to the destination */
+static void string_buffer_move(struct Ini_File *const destination, struct Ini_File *const source) {
+#ifdef USE_CUSTOM_STRING_ALLOCATOR
+    struct String_Buffer *last = source->strings;
+    size_t i, j;
+    if (last == NULL) {
+        return;
+    }
+    destination->strings_wasted += source->strings_wasted;
+    destination->strings_buffer_size = max_size(destination->strings_buffer_size, source->strings_buffer_size);
+    /* The space released in the buffers of the source can be reused by the destination */
+    for (i = 0; (source->free_strings != NULL) && (i < STRING_SIZE_CLASSES); i++) {
+        for (j = 0; j < source->free_strings[i].strings_size; j++) {
+            if (!string_free_list_insert(destination, i, source->free_strings[i].strings[j])) {
+                destination->strings_wasted += string_class_size(i);
+            }
+        }
+        source->free_strings[i].strings_size = 0;
+    }
+    if (destination->strings == NULL) {
+        destination->strings = source->strings;
+        destination->string_index = source->string_index;
+    } else {
+        /* The buffers are inserted after the first one, which is still used to store new strings.
+         * So the space left at the end of the first buffer of the source is retired. */
+        string_retire_space(destination, &string_buffer_data(source->strings)[source->string_index], source->strings->size - source->string_index);
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        last->next = destination->strings->next;
+        destination->strings->next = source->strings;
+    }
+    source->strings = NULL;
+#else
+    (void)destination;
+    (void)source;
+#endif
+}
+
+/* Moves the sections built by the workers to the final structure, in the order of the chunks */
+static Ini_File_Error ini_file_merge_workers(struct Ini_File *const ini_file, struct Ini_Parse_Worker *const workers, const size_t count) {
+    size_t i, sections = 0;
+    for (i = 0; i < count; i++) {
+        sections += workers[i].ini_file->sections_size;
+    }
+    ini_file->sections = ini_allocate(ini_file, (sections + 1) * sizeof(struct Ini_Section));
+    if (ini_file->sections == NULL) {
+        return ini_allocation;
+    }
+    ini_file->sections_capacity = sections + 1;
+    /* Only the first chunk may have properties declared before the first section */
+    ini_file->global_section = workers[0].ini_file->global_section;
+    memset(&workers[0].ini_file->global_section, 0, sizeof(struct Ini_Section));
+    for (i = 0; i < count; i++) {
+        struct Ini_File *const partial = workers[i].ini_file;
+        if (partial->current_section != &partial->global_section) {
+            ini_file->current_section = &ini_file->sections[ini_file->sections_size + (size_t)(partial->current_section - partial->sections)];
+        }
+        if (partial->sections_size > 0) {
+            memcpy(&ini_file->sections[ini_file->sections_size], partial->sections, partial->sections_size * sizeof(struct Ini_Section));
+            ini_file->sections_size += partial->sections_size;
+        }
+        partial->sections_size = 0;
+        string_buffer_move(ini_file, partial);
+        ini_file->lines_read += workers[i].lines;
+        ini_file->allocations += partial->allocations;
+        ini_file->bytes_moved += partial->bytes_moved;
+    }
+    return ini_no_error;
+}
+
+/* The partial structures of the workers use the same allocator as the final one, which
+ * takes over their arrays and strings */
+struct Ini_File *ini_file_parse_parallel_with_allocator(const char *const filename, const size_t threads, const int flags, const struct Ini_Allocator *const allocator, Ini_File_Error_Callback callback) {
+    Ini_File_Error error;
+    struct Ini_Parse_Worker *workers;
+    struct Ini_File *ini_file = NULL;
+    struct Ini_Line_Source source;
+    size_t i, count = threads;
+    int aborted = 0;
+    char *data;
+    size_t size;
+    const double start = current_seconds();
+    if ((allocator != NULL) && ((allocator->allocate == NULL) || (allocator->reallocate == NULL) || (allocator->release == NULL))) {
+        if (callback != NULL) {
+            callback(filename, 0, 0, NULL, ini_invalid_parameters);
+        }
+        return NULL;
+    }
+    error = map_file(filename, &data, &size);
+    source.data = data;
+    source.size = size;
+    source.filename = NULL;
+    if (error != ini_no_error) {
+        /* This is a critical error, so we don't proceed, even if the callback returns 0 */
+        if (callback != NULL) {
+            callback(filename, 0, 0, NULL, error);
+        }
+        return NULL;
+    }
+#ifdef USE_POSIX_THREADS
+    if (count == 0) {
+        const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        count = (processors > 0) ? (size_t)processors : 1;
+    }
+#endif
+    count = (count > MAX_PARALLEL_THREADS) ? MAX_PARALLEL_THREADS : count;
+    count = (count > (size / MIN_PARALLEL_CHUNK_SIZE)) ? (size / MIN_PARALLEL_CHUNK_SIZE) : count;
+    count = (count == 0) ? 1 : count;
+    workers = calloc(count, sizeof(struct Ini_Parse_Worker));
+    if (workers == NULL) {
+        error = ini_allocation;
+        goto ini_file_parse_parallel_end;
+    }
+    /* Splits the file in chunks of similar size, which start at the declaration of a section */
+    for (i = 0; i < count; i++) {
+        const char *const chunk_start = (i == 0) ? data : (workers[i - 1].data + workers[i - 1].len);
+        const char *const chunk_end = (i + 1 == count) ? (data + size) : find_section_declaration(data + (i + 1) * (size / count), data + size);
+        workers[i].data = (chunk_start != NULL) ? chunk_start : "";
+        workers[i].len = (chunk_end > chunk_start) ? (size_t)(chunk_end - chunk_start) : 0;
+        workers[i].offset = (i == 0) ? 0 : (workers[i - 1].offset + workers[i - 1].len);
+        workers[i].ini_file = ini_file_new_with_allocator(allocator);
+        if (workers[i].ini_file == NULL) {
+            error = ini_allocation;
+            goto ini_file_parse_parallel_end;
+        }
+        /* The mapping is released at the end, unless the strings reference it */
+        workers[i].ini_file->flags = ((flags & ini_memory_map) ? (flags | ini_zero_copy) : (flags & ~ini_zero_copy)) | ini_bulk_load;
+        workers[i].ini_file->flags &= ~(ini_hash_index | ini_intern_strings);
+    }
+    /* The line numbers of each chunk depend on the number of lines of the previous chunks */
+    ini_run_workers(workers, count, ini_count_lines_worker);
+    workers[0].first_line_number = 1;
+    for (i = 1; i < count; i++) {
+        workers[i].first_line_number = workers[i - 1].first_line_number + workers[i - 1].lines;
+    }
+    ini_run_workers(workers, count, ini_parse_worker);
+    for (i = 0; i < count; i++) {
+        if (workers[i].error != ini_no_error) {
+            error = workers[i].error;
+            goto ini_file_parse_parallel_end;
+        }
+    }
+    ini_file = ini_file_new_with_allocator(allocator);
+    if ((ini_file == NULL) || (ini_file_merge_workers(ini_file, workers, count) != ini_no_error)) {
+        error = ini_allocation;
+        goto ini_file_parse_parallel_end;
+    }
+    ini_file->flags = workers[0].ini_file->flags;
+    ini_file->bytes_read = size;
+    /* Reports the errors in the order they were found in the file */
+    for (i = 0; (i < count) && !aborted; i++) {
+        size_t j;
+        for (j = 0; (j < workers[i].log.errors_size) && !aborted && (callback != NULL); j++) {
+            const struct Ini_Error_Record *const record = &workers[i].log.errors[j];
+            aborted = callback(filename, record->line_number, record->column, record->line, record->error);
+        }
+    }
+    if (aborted || (ini_file_parse_finish(ini_file, flags, &source, filename, callback) != 0)) {
+        ini_file_free(ini_file);
+        ini_file = NULL;
+    } else if (ini_file->flags & ini_zero_copy) {
+        ini_file->source = data;
+        ini_file->source_size = size;
+        data = NULL;
+    }
+ini_file_parse_parallel_end:
+    if (error != ini_no_error) {
+        /* This is a critical error, so we don't proceed, even if the callback returns 0 */
+        if (callback != NULL) {
+            callback(filename, 0, 0, NULL, error);
+        }
+        ini_file_free(ini_file);
+        ini_file = NULL;
+    }
+    for (i = 0; (workers != NULL) && (i < count); i++) {
+        ini_error_log_free(&workers[i].log);
+        ini_file_free(workers[i].ini_file);
+    }
+    free(workers);
+    unmap_file(data, size);
+    if (ini_file != NULL) {
+        ini_file->parse_seconds = current_seconds() - start;
+    }
+    return ini_file;
+}
+
+struct Ini_File *ini_file_parse_parallel(const char *const filename, const size_t threads, const int flags, Ini_File_Error_Callback callback) {
+    return ini_file_parse_parallel_with_allocator(filename, threads, flags, NULL, callback);
+}
+
+#if defined(USE_POSIX_THREADS) && defined(USE_ATOMIC_OPERATIONS)
+/* The snapshots published by the reloader are protected by two reader counters, one for
+ * each epoch. The readers register themselves in the current epoch before loading the
+ * snapshot. After publishing a new snapshot, the writer flips the epoch and waits until
+ * the readers of the previous epoch leave, at which point no one can be using the old
+ * snapshot. The readers never wait, and only retry if the epoch changes while they are
+ * registering. */
+
+/* The modification time has a resolution of nanoseconds since POSIX.1-2008 */
+#if defined(__APPLE__) && defined(__MACH__)
+#define modification_time_ns(status) ((status)->st_mtimespec.tv_nsec)
+#else
+#define modification_time_ns(status) ((status)->st_mtim.tv_nsec)
+#endif
+
+struct Ini_Reloader {
+    char *filename;
+    int flags;
+    Ini_File_Error_Callback callback;
+    struct Ini_Snapshot *snapshot;
+    int epoch;
+    size_t readers[2];
+    /* Serializes the reloads */
+    pthread_mutex_t mutex;
+    /* Attributes of the file when it was last parsed, used to detect changes */
+    dev_t device;
+    ino_t inode;
+    time_t modification_time;
+    long modification_time_ns;
+    off_t size;
+    /* Background thread that polls the file */
+    pthread_t thread;
+    int running;
+    int stop;
+    int requested;
+    unsigned long interval;
+};
+
+/* Parses the file and publishes the new snapshot. Must be called with the mutex locked. */
+static Ini_File_Error ini_reloader_update(struct Ini_Reloader *const reloader, const struct stat *const status) {
+    struct Ini_File *ini_file;
+    struct Ini_Snapshot *snapshot, *old_snapshot;
+    int epoch;
+    ini_file = ini_file_parse_with_flags(reloader->filename, reloader->flags, reloader->callback);
+    if (ini_file == NULL) {
+        return ini_parsing_aborted;
+    }
+    snapshot = ini_file_freeze(ini_file);
+    ini_file_free(ini_file);
+    if (snapshot == NULL) {
+        return ini_allocation;
+    }
+    reloader->device = status->st_dev;
+    reloader->inode = status->st_ino;
+    reloader->modification_time = status->st_mtime;
+    reloader->modification_time_ns = modification_time_ns(status);
+    reloader->size = status->st_size;
+    old_snapshot = reloader->snapshot;
+    atomic_store(&reloader->snapshot, snapshot);
+    epoch = reloader->epoch;
+    atomic_store(&reloader->epoch, !epoch);
+    while (atomic_load(&reloader->readers[epoch]) != 0) {
+        sched_yield();
+    }
+    ini_snapshot_free(old_snapshot);
+    return ini_no_error;
+}
+
+static Ini_File_Error ini_reloader_refresh(struct Ini_Reloader *const reloader, const int force) {
+    Ini_File_Error error = ini_no_error;
+    struct stat status;
+    if (reloader == NULL) {
+        return ini_invalid_parameters;
+    }
+    pthread_mutex_lock(&reloader->mutex);
+    if (stat(reloader->filename, &status) != 0) {
+        error = ini_couldnt_open_file;
+    } else if (force || (reloader->snapshot == NULL) ||
+        (status.st_dev != reloader->device) || (status.st_ino != reloader->inode) ||
+        (status.st_mtime != reloader->modification_time) || (modification_time_ns(&status) != reloader->modification_time_ns) ||
+        (status.st_size != reloader->size)) {
+        error = ini_reloader_update(reloader, &status);
+    }
+    pthread_mutex_unlock(&reloader->mutex);
+    return error;
+}
+
+struct Ini_Reloader *ini_reloader_new(const char *const filename, const int flags, Ini_File_Error_Callback callback) {
+    struct Ini_Reloader *reloader;
+    if (filename == NULL) {
+        return NULL;
+    }
+    reloader = malloc(sizeof(struct Ini_Reloader));
+    if (reloader == NULL) {
+        return NULL;
+    }
+    memset(reloader, 0, sizeof(struct Ini_Reloader));
+    reloader->filename = malloc(strlen(filename) + 1);
+    if ((reloader->filename == NULL) || (pthread_mutex_init(&reloader->mutex, NULL) != 0)) {
+        free(reloader->filename);
+        free(reloader);
+        return NULL;
+    }
+    strcpy(reloader->filename, filename);
+    reloader->flags = flags;
+    reloader->callback = callback;
+    if (ini_reloader_refresh(reloader, 1) != ini_no_error) {
+        ini_reloader_free(reloader);
+        return NULL;
+    }
+    return reloader;
+}
+
+void ini_reloader_free(struct Ini_Reloader *const reloader) {
+    if (reloader == NULL) {
+        return;
+    }
+    ini_reloader_stop(reloader);
+    pthread_mutex_destroy(&reloader->mutex);
+    ini_snapshot_free(reloader->snapshot);
+    free(reloader->filename);
+    free(reloader);
+}
+
+Ini_File_Error ini_reloader_check(struct Ini_Reloader *const reloader) {
+    return ini_reloader_refresh(reloader, 0);
+}
+
+Ini_File_Error ini_reloader_reload(struct Ini_Reloader *const reloader) {
+    return ini_reloader_refresh(reloader, 1);
+}
+
+void ini_reloader_request(struct Ini_Reloader *const reloader) {
+    if (reloader != NULL) {
+        atomic_store(&reloader->requested, 1);
+    }
+}
+
+const struct Ini_Snapshot *ini_reloader_acquire(struct Ini_Reloader *const reloader, int *const epoch) {
+    int current;
+    if ((reloader == NULL) || (epoch == NULL)) {
+        return NULL;
+    }
+    for (;;) {
+        current = atomic_load(&reloader->epoch);
+        atomic_add(&reloader->readers[current], 1);
+        /* If the epoch changed, the writer may not be waiting for this counter anymore */
+        if (atomic_load(&reloader->epoch) == current) {
+            break;
+        }
+        atomic_sub(&reloader->readers[current], 1);
+    }
+    *epoch = current;
+    return atomic_load(&reloader->snapshot);
+}
+
+void ini_reloader_release(struct Ini_Reloader *const reloader, const int epoch) {
+    if ((reloader != NULL) && ((epoch == 0) || (epoch == 1))) {
+        atomic_sub(&reloader->readers[epoch], 1);
+    }
+}
+
+static void *ini_reloader_poll(void *const argument) {
+    struct Ini_Reloader *const reloader = argument;
+    struct timespec interval;
+    interval.tv_sec = (time_t)(reloader->interval / 1000);
+    interval.tv_nsec = (long)(reloader->interval % 1000) * 1000000L;
+    while (!atomic_load(&reloader->stop)) {
+        /* The errors are reported by the callback, and the previous snapshot is kept */
+        if (atomic_load(&reloader->requested)) {
+            atomic_store(&reloader->requested, 0);
+            ini_reloader_reload(reloader);
+        } else {
+            ini_reloader_check(reloader);
+        }
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+Ini_File_Error ini_reloader_start(struct Ini_Reloader *const reloader, const unsigned long interval) {
+    /* An interval of zero would check the file in a busy loop */
+    if ((reloader == NULL) || reloader->running || (interval == 0)) {
+        return ini_invalid_parameters;
+    }
+    reloader->interval = interval;
+    reloader->stop = 0;
+    if (pthread_create(&reloader->thread, NULL, ini_reloader_poll, reloader) != 0) {
+        return ini_allocation;
+    }
+    reloader->running = 1;
+    return ini_no_error;
+}
+
+void ini_reloader_stop(struct Ini_Reloader *const reloader) {
+    if ((reloader == NULL) || !reloader->running) {
+        return;
+    }
+    atomic_store(&reloader->stop, 1);
+    pthread_join(reloader->thread, NULL);
+    reloader->running = 0;
+}
+#endif  /* USE_POSIX_THREADS && USE_ATOMIC_OPERATIONS */
+
+/* Size of the text written by ini_section_print_to */
+static size_t ini_section_serialized_size(const struct Ini_Section *const ini_section) {
+    size_t property_index, size = 0;
+    if ((ini_section->name != NULL) && (ini_section->name_len > 0)) {
+        /* [name]\n */
+        size += ini_section->name_len + 3;
+    }
+    for (property_index = 0; property_index < ini_section->properties_size; property_index++) {
+        /* key = value\n */
+        size += ini_section->properties[property_index].key_len + ini_section->properties[property_index].value_len + 4;
+    }
+    return size;
+}
+
+size_t ini_file_serialized_size(const struct Ini_File *const ini_file) {
+    size_t section_index, size = 0;
+    if (ini_file == NULL) {
+        return 0;
+    }
+    if (ini_file->global_section.properties_size > 0) {
+        size += ini_section_serialized_size(&ini_file->global_section) + 1;
+    }
+    for (section_index = 0; section_index < ini_file->sections_size; section_index++) {
+        size += ini_section_serialized_size(&ini_file->sections[section_index]) + 1;
+    }
+    return size;
+}
+
+static char *serialize_string(char *cursor, const char *const str, const size_t len) {
+    if (len > 0) {
+        memcpy(cursor, str, len);
     }
-    return error;
+    return cursor + len;
 }
 
-Ini_File_Error ini_section_find_property(struct Ini_Section *const ini_section, const char *const key, char **const value)  {
-    Ini_File_Error error;
+static char *ini_section_serialize(const struct Ini_Section *const ini_section, char *cursor) {
     size_t property_index;
-    if ((ini_section == NULL) || (value == NULL)) {
-        return ini_invalid_parameters;
-    }
-    if (key[0] == '\0') {
-        return ini_invalid_parameters;
+    if ((ini_section->name != NULL) && (ini_section->name_len > 0)) {
+        *cursor++ = '[';
+        cursor = serialize_string(cursor, ini_section->name, ini_section->name_len);
+        *cursor++ = ']';
+        *cursor++ = '\n';
     }
-    error = ini_file_find_key_index(ini_section, key, strlen(key), &property_index);
-    if (error == ini_no_error) {
-        *value = ini_section->properties[property_index].value;
+    for (property_index = 0; property_index < ini_section->properties_size; property_index++) {
+        const struct Key_Value_Pair *const property = &ini_section->properties[property_index];
+        cursor = serialize_string(cursor, property->key, property->key_len);
+        cursor = serialize_string(cursor, " = ", 3);
+        cursor = serialize_string(cursor, property->value, property->value_len);
+        *cursor++ = '\n';
     }
-    return error;
+    *cursor++ = '\n';
+    return cursor;
 }
 
-Ini_File_Error ini_file_find_property(struct Ini_File *const ini_file, const char *const section, const char *const key, char **const value) {
-    Ini_File_Error error;
-    struct Ini_Section *ini_section;
-    if ((ini_file == NULL) || (key == NULL) || (value == NULL)) {
+Ini_File_Error ini_file_serialize_to_buffer(const struct Ini_File *const ini_file, char *const buffer, const size_t buffer_size, size_t *const size) {
+    size_t section_index;
+    char *cursor = buffer;
+    if ((ini_file == NULL) || (size == NULL)) {
         return ini_invalid_parameters;
     }
-    if (key[0] == '\0') {
-        return ini_invalid_parameters;
+    *size = ini_file_serialized_size(ini_file);
+    if ((buffer == NULL) || (buffer_size < *size)) {
+        return ini_allocation;
     }
-    error = ini_file_find_section(ini_file, section, &ini_section);
-    if (error != ini_no_error) {
-        return error;
+    if (ini_file->global_section.properties_size > 0) {
+        cursor = ini_section_serialize(&ini_file->global_section, cursor);
+    }
+    for (section_index = 0; section_index < ini_file->sections_size; section_index++) {
+        cursor = ini_section_serialize(&ini_file->sections[section_index], cursor);
     }
-    return ini_section_find_property(ini_section, key, value);
+    return ini_no_error;
 }
 
-static Ini_File_Error convert_to_integer(const char *const value, long *const integer) {
-    char *end;
-    long i_value = strtol(value, &end, 10);
-    if (*end != '\0') {
-        return ini_not_integer;
+/* Writes the ranges, one after the other, to a temporary file in the same directory, which
+ * replaces the destination only after its content is stored, so the destination is never
+ * left truncated */
+#ifdef USE_POSIX_SYSTEM_CALLS
+/* Number of names tried by create_temporary_file before giving up */
+#define TEMPORARY_FILE_ATTEMPTS 100
+
+/* Creates a new file named after the destination, like mkstemp, but with the permissions
+ * 0666 restricted by the umask, which are the ones of the files created by fopen. The names
+ * are derived from the process, the time and the stack of the thread, and another one is
+ * tried if the file already exists. */
+static int create_temporary_file(char *const temporary, const size_t filename_len) {
+    unsigned long seed = ((unsigned long)getpid() * 2654435761UL) ^ (unsigned long)time(NULL) ^ (unsigned long)(size_t)&seed;
+    int attempt, fd = -1;
+    for (attempt = 0; (attempt < TEMPORARY_FILE_ATTEMPTS) && (fd < 0); attempt++) {
+        seed = (seed * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+        sprintf(&temporary[filename_len], ".%06lx", (seed >> 8) & 0xFFFFFFUL);
+        fd = open(temporary, O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if ((fd < 0) && (errno != EEXIST)) {
+            break;
+        }
     }
-    *integer = i_value;
-    return ini_no_error;
+    return fd;
 }
 
-Ini_File_Error ini_section_find_integer(struct Ini_Section *const ini_section, const char *const key, long *const integer) {
-    char *value;
-    Ini_File_Error error;
-    if (integer == NULL) {
-        return ini_invalid_parameters;
+/* Maximum number of symbolic links followed by resolve_symbolic_link */
+#define MAX_SYMBOLIC_LINKS 40
+
+/* The rename would replace a symbolic link by a regular file, so the file referenced by it
+ * is replaced instead, as fopen would do. If the file is a link, stores at target the path
+ * of the file it references, following the chain of links, which must be released by free.
+ * Otherwise, stores NULL. The relative links are resolved from the directory of the link. */
+static Ini_File_Error resolve_symbolic_link(const char *const filename, char **const target) {
+    struct stat status;
+    const char *path = filename;
+    int links;
+    *target = NULL;
+    for (links = 0; (lstat(path, &status) == 0) && S_ISLNK(status.st_mode); links++) {
+        const char *const slash = strrchr(path, '/');
+        const size_t directory_len = (slash == NULL) ? 0 : (size_t)(slash - path + 1);
+        size_t capacity = ((size_t)status.st_size > 0) ? ((size_t)status.st_size + 1) : 256;
+        ssize_t len;
+        char *link = NULL, *new_target;
+        /* The size of some links isn't known, so the buffer grows until the whole link fits */
+        do {
+            char *const new_link = realloc(link, capacity);
+            if (new_link == NULL) {
+                free(link);
+                free(*target);
+                *target = NULL;
+                return ini_allocation;
+            }
+            link = new_link;
+            len = readlink(path, link, capacity);
+            capacity *= 2;
+        } while ((len >= 0) && ((size_t)len >= capacity / 2));
+        if ((len <= 0) || (links == MAX_SYMBOLIC_LINKS)) {
+            free(link);
+            free(*target);
+            *target = NULL;
+            return ini_couldnt_open_file;
+        }
+        new_target = malloc(directory_len + (size_t)len + 1);
+        if (new_target == NULL) {
+            free(link);
+            free(*target);
+            *target = NULL;
+            return ini_allocation;
+        }
+        if (link[0] == '/') {
+            memcpy(new_target, link, (size_t)len);
+            new_target[len] = '\0';
+        } else {
+            memcpy(new_target, path, directory_len);
+            memcpy(&new_target[directory_len], link, (size_t)len);
+            new_target[directory_len + (size_t)len] = '\0';
+        }
+        free(link);
+        free(*target);
+        *target = new_target;
+        path = new_target;
     }
-    error = ini_section_find_property(ini_section, key, &value);
-    if (error != ini_no_error) {
-        return error;
+    return ini_no_error;
+}
+
+/* Gives the temporary file the owner, group and permissions of the file replaced. The owner
+ * can only be changed by privileged users, so the group alone is tried if it fails. The
+ * permissions are changed last, because changing the owner may clear the set-user-ID bit. */
+static void copy_file_attributes(const int fd, const struct stat *const status) {
+    if ((status->st_uid != geteuid()) || (status->st_gid != getegid())) {
+        if (fchown(fd, status->st_uid, status->st_gid) != 0) {
+            if (fchown(fd, (uid_t)-1, status->st_gid) != 0) {
+                /* The temporary file keeps the owner and group of the process */
+            }
+        }
     }
-    return convert_to_integer(value, integer);
+    fchmod(fd, status->st_mode & 07777);
 }
 
-Ini_File_Error ini_file_find_integer(struct Ini_File *const ini_file, const char *const section, const char *const key, long *const integer) {
-    char *value;
-    Ini_File_Error error;
-    if (integer == NULL) {
-        return ini_invalid_parameters;
+/* Flushes the directory of the file, so the rename survives a power failure. The systems
+ * that can't flush directories report EINVAL, which is ignored. */
+static Ini_File_Error sync_directory(const char *const filename) {
+    const char *const slash = strrchr(filename, '/');
+    const size_t len = (slash == NULL) ? 0 : ((slash == filename) ? 1 : (size_t)(slash - filename));
+    char *const directory = malloc(len + 2);
+    int fd, result;
+    if (directory == NULL) {
+        return ini_allocation;
     }
-    error = ini_file_find_property(ini_file, section, key, &value);
-    if (error != ini_no_error) {
-        return error;
+    if (len == 0) {
+        strcpy(directory, ".");
+    } else {
+        memcpy(directory, filename, len);
+        directory[len] = '\0';
+    }
+    fd = open(directory, O_RDONLY);
+    free(directory);
+    if (fd < 0) {
+        return ini_couldnt_open_file;
+    }
+    result = fsync(fd);
+    if ((result != 0) && (errno == EINVAL)) {
+        result = 0;
     }
-    return convert_to_integer(value, integer);
+    close(fd);
+    return (result == 0) ? ini_no_error : ini_couldnt_open_file;
 }
+#endif
 
-static Ini_File_Error convert_to_unsigned(const char *const value, unsigned long *const uint) {
-    char *end;
-    unsigned long ui_value = strtoul(value, &end, 10);
-    if (*end != '\0') {
-        return ini_not_unsigned;
+static Ini_File_Error write_file_atomically(const char *filename, const struct Ini_Output_Range *const ranges, const size_t ranges_size) {
+    Ini_File_Error error = ini_no_error;
+    size_t i, filename_len;
+    char *temporary;
+#ifdef USE_POSIX_SYSTEM_CALLS
+    struct stat status;
+    char *target;
+    int fd;
+    error = resolve_symbolic_link(filename, &target);
+    if (error != ini_no_error) {
+        return error;
     }
-    *uint = ui_value;
-    return ini_no_error;
+    if (target != NULL) {
+        filename = target;
+    }
+#else
+    FILE *file;
+#endif
+    filename_len = strlen(filename);
+    temporary = malloc(filename_len + 8);
+    if (temporary == NULL) {
+        error = ini_allocation;
+        goto write_file_atomically_end;
+    }
+    memcpy(temporary, filename, filename_len);
+    strcpy(&temporary[filename_len], ".XXXXXX");
+#ifdef USE_POSIX_SYSTEM_CALLS
+    fd = create_temporary_file(temporary, filename_len);
+    if (fd < 0) {
+        error = ini_couldnt_open_file;
+        goto write_file_atomically_end;
+    }
+    /* The owner and the permissions of the file replaced are kept */
+    if (stat(filename, &status) == 0) {
+        copy_file_attributes(fd, &status);
+    }
+    for (i = 0; (i < ranges_size) && (error == ini_no_error); i++) {
+        size_t written = 0;
+        while (written < ranges[i].size) {
+            const ssize_t result = write(fd, ranges[i].data + written, ranges[i].size - written);
+            if (result <= 0) {
+                error = ini_couldnt_open_file;
+                break;
+            }
+            written += (size_t)result;
+        }
+    }
+    if ((error == ini_no_error) && (fsync(fd) != 0)) {
+        error = ini_couldnt_open_file;
+    }
+    if (close(fd) != 0) {
+        error = ini_couldnt_open_file;
+    }
+#else
+    file = fopen(temporary, "wb");
+    if (file == NULL) {
+        error = ini_couldnt_open_file;
+        goto write_file_atomically_end;
+    }
+    for (i = 0; (i < ranges_size) && (error == ini_no_error); i++) {
+        if ((ranges[i].size > 0) && (fwrite(ranges[i].data, ranges[i].size, 1, file) != 1)) {
+            error = ini_couldnt_open_file;
+        }
+    }
+    if (fclose(file) != 0) {
+        error = ini_couldnt_open_file;
+    }
+    /* Some systems don't replace an existing file in the rename */
+    if (error == ini_no_error) {
+        remove(filename);
+    }
+#endif
+    if ((error != ini_no_error) || (rename(temporary, filename) != 0)) {
+        remove(temporary);
+        error = ini_couldnt_open_file;
+    }
+#ifdef USE_POSIX_SYSTEM_CALLS
+    if (error == ini_no_error) {
+        error = sync_directory(filename);
+    }
+#endif
+write_file_atomically_end:
+    free(temporary);
+#ifdef USE_POSIX_SYSTEM_CALLS
+    free(target);
+#endif
+    return error;
 }
 
-Ini_File_Error ini_section_find_unsigned(struct Ini_Section *const ini_section, const char *const key, unsigned long *const uint) {
-    char *value;
+Ini_File_Error ini_file_save_with_buffer(const struct Ini_File *const ini_file, const char *const filename, char *const buffer, const size_t buffer_size) {
     Ini_File_Error error;
-    if (uint == NULL) {
+    char *data = buffer;
+    size_t size;
+    if ((ini_file == NULL) || (filename == NULL)) {
         return ini_invalid_parameters;
     }
-    error = ini_section_find_property(ini_section, key, &value);
-    if (error != ini_no_error) {
-        return error;
+    size = ini_file_serialized_size(ini_file);
+    if ((data == NULL) || (buffer_size < size)) {
+        data = malloc(max_size(size, 1));
+        if (data == NULL) {
+            return ini_allocation;
+        }
+    }
+    error = ini_file_serialize_to_buffer(ini_file, data, size, &size);
+    if (error == ini_no_error) {
+        struct Ini_Output_Range range;
+        range.data = data;
+        range.size = size;
+        error = write_file_atomically(filename, &range, 1);
+    }
+    if (data != buffer) {
+        free(data);
     }
-    return convert_to_unsigned(value, uint);
+    return error;
 }
 
-Ini_File_Error ini_file_find_unsigned(struct Ini_File *const ini_file, const char *const section, const char *const key, unsigned long *const uint) {
-    char *value;
-    Ini_File_Error error;
-    if (uint == NULL) {
-        return ini_invalid_parameters;
+Ini_File_Error ini_file_save(const struct Ini_File *const ini_file, const char *const filename) {
+    return ini_file_save_with_buffer(ini_file, filename, NULL, 0);
+}
+
+/* Value changed by ini_file_patch. The total sizes of the old and new values up to this
+ * edit, including it, are used to update the offsets of the following properties. */
+struct Ini_Patch_Edit {
+    struct Key_Value_Pair *property;
+    const char *value;
+    size_t value_len;
+    char *stored_value;
+    size_t old_size;
+    size_t new_size;
+};
+
+static int compare_edits(const struct Ini_Patch_Edit *const a, const struct Ini_Patch_Edit *const b) {
+    return (a->property->value_offset > b->property->value_offset) - (a->property->value_offset < b->property->value_offset);
+}
+
+merge_sort_function(sort_edits, struct Ini_Patch_Edit, compare_edits)
+
+/* The new value must be read back exactly as it is, so it can't have comments, new lines
+ * or white spaces at its ends */
+static int is_valid_patch_value(const char *const value, const size_t value_len) {
+    size_t i;
+    if ((value_len == 0) || is_char_class(value[0], CHAR_SPACE) || is_char_class(value[value_len - 1], CHAR_SPACE)) {
+        return 0;
     }
-    error = ini_file_find_property(ini_file, section, key, &value);
-    if (error != ini_no_error) {
-        return error;
+    for (i = 0; i < value_len; i++) {
+        if (is_char_class(value[i], CHAR_VALUE_END)) {
+            return 0;
+        }
     }
-    return convert_to_unsigned(value, uint);
+    return 1;
 }
 
-static Ini_File_Error convert_to_double(const char *const value, double *const real) {
-    char *end;
-    double d_value = strtod(value, &end);
-    if (*end != '\0') {
-        return ini_not_double;
+/* Writes the new values over the old ones, when all of them have the same size. Used only
+ * with the flag ini_patch_in_place, as the file is changed while other programs may read it. */
+static Ini_File_Error ini_file_patch_in_place(const char *const filename, const struct Ini_Patch_Edit *const edits, const size_t edits_size) {
+    Ini_File_Error error = ini_no_error;
+    size_t i;
+#ifdef USE_POSIX_SYSTEM_CALLS
+    const int fd = open(filename, O_WRONLY);
+    if (fd < 0) {
+        return ini_couldnt_open_file;
     }
-    *real = d_value;
-    return ini_no_error;
+    for (i = 0; (i < edits_size) && (error == ini_no_error); i++) {
+        if (pwrite(fd, edits[i].value, edits[i].value_len, (off_t)edits[i].property->value_offset) != (ssize_t)edits[i].value_len) {
+            error = ini_couldnt_open_file;
+        }
+    }
+    if ((error == ini_no_error) && (fsync(fd) != 0)) {
+        error = ini_couldnt_open_file;
+    }
+    if (close(fd) != 0) {
+        error = ini_couldnt_open_file;
+    }
+#else
+    FILE *const file = fopen(filename, "r+b");
+    if (file == NULL) {
+        return ini_couldnt_open_file;
+    }
+    for (i = 0; (i < edits_size) && (error == ini_no_error); i++) {
+        if ((fseek(file, (long)edits[i].property->value_offset, SEEK_SET) != 0) ||
+            (fwrite(edits[i].value, edits[i].value_len, 1, file) != 1)) {
+            error = ini_couldnt_open_file;
+        }
+    }
+    if (fclose(file) != 0) {
+        error = ini_couldnt_open_file;
+    }
+#endif
+    return error;
 }
 
-Ini_File_Error ini_section_find_double(struct Ini_Section *const ini_section, const char *const key, double *const real)  {
-    char *value;
+/* Writes the regions of the file between the edits, directly from the mapped file, and the
+ * new values to a new file, which replaces the old one */
+static Ini_File_Error ini_file_patch_splice(const char *const filename, const char *const data, const size_t size, const struct Ini_Patch_Edit *const edits, const size_t edits_size) {
     Ini_File_Error error;
-    if (real == NULL) {
-        return ini_invalid_parameters;
+    struct Ini_Output_Range *const ranges = malloc((2 * edits_size + 1) * sizeof(struct Ini_Output_Range));
+    size_t i, position = 0;
+    if (ranges == NULL) {
+        return ini_allocation;
     }
-    error = ini_section_find_property(ini_section, key, &value);
-    if (error != ini_no_error) {
-        return error;
+    for (i = 0; i < edits_size; i++) {
+        const size_t offset = edits[i].property->value_offset;
+        ranges[2 * i].data = data + position;
+        ranges[2 * i].size = offset - position;
+        ranges[2 * i + 1].data = edits[i].value;
+        ranges[2 * i + 1].size = edits[i].value_len;
+        position = offset + edits[i].property->value_len;
     }
-    return convert_to_double(value, real);
+    ranges[2 * edits_size].data = data + position;
+    ranges[2 * edits_size].size = size - position;
+    error = write_file_atomically(filename, ranges, 2 * edits_size + 1);
+    free(ranges);
+    return error;
 }
 
-Ini_File_Error ini_file_find_double(struct Ini_File *const ini_file, const char *const section, const char *const key, double *const real) {
-    char *value;
-    Ini_File_Error error;
-    if (real == NULL) {
-        return ini_invalid_parameters;
+/* Returns the offset in the new file of the byte at offset in the old one, which isn't part
+ * of an old value, except at its beginning */
+static size_t patched_offset(const size_t offset, const struct Ini_Patch_Edit *const edits, const size_t edits_size) {
+    size_t low = 0, high = edits_size;
+    /* Number of edits before the offset */
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (edits[middle].property->value_offset < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
     }
-    error = ini_file_find_property(ini_file, section, key, &value);
-    if (error != ini_no_error) {
-        return error;
+    return (low > 0) ? (offset - edits[low - 1].old_size + edits[low - 1].new_size) : offset;
+}
+
+/* Updates the offsets of the values declared after the edits */
+static void ini_section_shift_offsets(struct Ini_Section *const ini_section, const struct Ini_Patch_Edit *const edits, const size_t edits_size) {
+    size_t i;
+    for (i = 0; i < ini_section->properties_size; i++) {
+        struct Key_Value_Pair *const property = &ini_section->properties[i];
+        if (property->line_number != 0) {
+            property->value_offset = patched_offset(property->value_offset, edits, edits_size);
+        }
     }
-    return convert_to_double(value, real);
 }
 
-static size_t max_size(const size_t a, const size_t b) {
-    return ((a > b) ? a : b);
+/* Moves the string, if it references the old content of the file, to the same position of
+ * the new content. The old values changed are moved to the new values. */
+static char *rebase_string(char *const str, const char *const old_data, const size_t old_size, char *const new_data, const struct Ini_Patch_Edit *const edits, const size_t edits_size) {
+    if ((str == NULL) || (str < old_data) || (str >= old_data + old_size)) {
+        return str;
+    }
+    return new_data + patched_offset((size_t)(str - old_data), edits, edits_size);
 }
 
-#define array_resize(array, default_cap) \
-    do { \
-        if ((array ## _size + 1) >= array ## _capacity) { \
-            const size_t new_cap = max_size(2 * array ## _capacity, default_cap); \
-            void *const new_array = realloc(array, new_cap * sizeof(*array)); \
-            if (new_array == NULL) { \
-                return ini_allocation; \
-            } \
-            array = new_array; \
-            array ## _capacity = new_cap; \
-        } \
-    } while (0)
+static void ini_section_rebase_strings(struct Ini_Section *const ini_section, const char *const old_data, const size_t old_size, char *const new_data, const struct Ini_Patch_Edit *const edits, const size_t edits_size) {
+    size_t i;
+    ini_section->name = rebase_string(ini_section->name, old_data, old_size, new_data, edits, edits_size);
+    for (i = 0; i < ini_section->properties_size; i++) {
+        struct Key_Value_Pair *const property = &ini_section->properties[i];
+        property->key = rebase_string(property->key, old_data, old_size, new_data, edits, edits_size);
+        property->value = rebase_string(property->value, old_data, old_size, new_data, edits, edits_size);
+    }
+}
 
-Ini_File_Error ini_file_add_section_sized(struct Ini_File *const ini_file, const char *const name, const size_t name_len) {
-    size_t section_index;
-    char *copied_name;
-    if (ini_file == NULL) {
-        return ini_invalid_parameters;
+/* The strings of the structures parsed with the flag ini_memory_map reference the mapping of
+ * the file, so the new file is mapped and all the strings are moved to it. The new values
+ * are checked, so a file replaced again in the meantime isn't used. If the new file can't be
+ * used, the structure keeps referencing the old one. */
+static Ini_File_Error ini_file_remap_source(struct Ini_File *const ini_file, const char *const filename, const struct Ini_Patch_Edit *const edits, const size_t edits_size) {
+    const size_t expected_size = ini_file->source_size - edits[edits_size - 1].old_size + edits[edits_size - 1].new_size;
+    Ini_File_Error error;
+    char *data;
+    size_t i, size;
+    error = map_file(filename, &data, &size);
+    if (error != ini_no_error) {
+        return error;
     }
-    if ((name == NULL) || (name_len == 0)) {
-        return ini_section_not_provided;
+    for (i = 0; (i < edits_size) && (size == expected_size); i++) {
+        const size_t offset = patched_offset(edits[i].property->value_offset, edits, edits_size);
+        if (memcmp(data + offset, edits[i].value, edits[i].value_len) != 0) {
+            break;
+        }
     }
-    if (ini_file_find_section_index(ini_file, name, name_len, &section_index) == ini_no_error) {
-        /* There is already a section with that name so we just update the current section */
-        ini_file->current_section = &ini_file->sections[section_index];
-        return ini_no_error;
+    if ((size != expected_size) || (i < edits_size)) {
+        unmap_file(data, size);
+        return ini_couldnt_open_file;
     }
-    /* Check if we need expand the array of sections */
-    array_resize(ini_file->sections, INITIAL_SECTIONS_CAPACITY);
-    /* Allocates memory to store the section name */
-    copied_name = copy_sized_string(ini_file, name, name_len);
-    if (copied_name == NULL) {
-        return ini_allocation;
+    ini_section_rebase_strings(&ini_file->global_section, ini_file->source, ini_file->source_size, data, edits, edits_size);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        ini_section_rebase_strings(&ini_file->sections[i], ini_file->source, ini_file->source_size, data, edits, edits_size);
     }
-    /* Updates the current section */
-    ini_file->current_section = &ini_file->sections[section_index];
-    /* Moves the sections to insert the new section in the middle, keeping the array sorted by names */
-    memmove((ini_file->current_section + 1), ini_file->current_section, (ini_file->sections_size - section_index)*sizeof(struct Ini_Section));
-    memset(ini_file->current_section, 0, sizeof(struct Ini_Section));
-    ini_file->current_section->name = copied_name;
-    ini_file->sections_size++;
+    unmap_file(ini_file->source, ini_file->source_size);
+    ini_file->source = data;
+    ini_file->source_size = size;
     return ini_no_error;
 }
 
-Ini_File_Error ini_file_add_section(struct Ini_File *const ini_file, const char *const name) {
-    if (name == NULL) {
-        return ini_section_not_provided;
+Ini_File_Error ini_file_patch_with_flags(struct Ini_File *const ini_file, const char *const filename, const Ini_Patch *const patches, const size_t patches_size, const int flags) {
+    Ini_File_Error error = ini_no_error;
+    struct Ini_Patch_Edit *edits;
+    size_t i, size = 0;
+    char *data = NULL;
+    int same_size = 1, mapped;
+    if ((ini_file == NULL) || (filename == NULL) || ((patches == NULL) && (patches_size > 0)) || (ini_file->flags & ini_bulk_load)) {
+        return ini_invalid_parameters;
     }
-    return ini_file_add_section_sized(ini_file, name, strlen(name));
-}
-
-Ini_File_Error ini_file_add_property_sized(struct Ini_File *const ini_file, const char *const key, const size_t key_len, const char *const value, const size_t value_len) {
-    size_t property_index;
-    struct Key_Value_Pair *property;
-    char *copied_key, *copied_value;
-    if (ini_file == NULL) {
+    /* The strings of the buffers parsed in the zero-copy mode belong to the caller, so the new
+     * values would reference the memory of the caller too */
+    mapped = (ini_file->source != NULL);
+    if ((ini_file->flags & ini_zero_copy) && !mapped) {
         return ini_invalid_parameters;
     }
-    if ((key == NULL) || (key_len == 0)) {
-        return ini_key_not_provided;
+    if (patches_size == 0) {
+        return ini_no_error;
     }
-    if ((value == NULL) || (value_len == 0)) {
-        return ini_value_not_provided;
+    /* The second half of the array is used by the sort */
+    edits = malloc(2 * patches_size * sizeof(struct Ini_Patch_Edit));
+    if (edits == NULL) {
+        return ini_allocation;
     }
-    if (ini_file_find_key_index(ini_file->current_section, key, key_len, &property_index) == ini_no_error) {
-        /* There is already a property with that key name, which is not allowed */
-        return ini_repeated_key;
+    memset(edits, 0, patches_size * sizeof(struct Ini_Patch_Edit));
+    for (i = 0; (i < patches_size) && (error == ini_no_error); i++) {
+        error = ini_file_find_pair(ini_file, patches[i].section, patches[i].key, &edits[i].property);
+        if (error != ini_no_error) {
+            break;
+        }
+        edits[i].value = patches[i].value;
+        edits[i].value_len = (patches[i].value != NULL) ? strlen(patches[i].value) : 0;
+        /* Only the properties read from the file can be patched */
+        if ((edits[i].property->line_number == 0) || !is_valid_patch_value(edits[i].value, edits[i].value_len)) {
+            error = ini_invalid_parameters;
+        }
+        same_size = same_size && (edits[i].value_len == edits[i].property->value_len);
     }
-    /* Check if we need expand the array of properties */
-    array_resize(ini_file->current_section->properties, INITIAL_PROPERTIES_CAPACITY);
-    copied_key = copy_sized_string(ini_file, key, key_len);
-    if (copied_key == NULL) {
-        return ini_allocation;
+    if (error == ini_no_error) {
+        sort_edits(edits, edits + patches_size, patches_size);
+        error = map_file(filename, &data, &size);
     }
-    copied_value = copy_sized_string(ini_file, value, value_len);
-    if (copied_value == NULL) {
-#ifndef USE_CUSTOM_STRING_ALLOCATOR
-        free(copied_key);
-#endif
-        return ini_allocation;
+    for (i = 0; (i < patches_size) && (error == ini_no_error); i++) {
+        const struct Key_Value_Pair *const property = edits[i].property;
+        /* The same property can't be changed twice, and the file must not have been changed,
+         * which is detected by comparing it with the value in memory, so the values changed
+         * in memory since they were parsed are rejected too */
+        if (((i > 0) && (edits[i - 1].property == property)) || (property->value_offset > size) ||
+            (property->value_len > size - property->value_offset) ||
+            (memcmp(data + property->value_offset, property->value, property->value_len) != 0) ||
+            (mapped && (size != ini_file->source_size))) {
+            error = ini_invalid_parameters;
+            break;
+        }
+        edits[i].old_size = ((i > 0) ? edits[i - 1].old_size : 0) + property->value_len;
+        edits[i].new_size = ((i > 0) ? edits[i - 1].new_size : 0) + edits[i].value_len;
+        /* The new values of the mapped structures are read from the new file */
+        if (!mapped) {
+            edits[i].stored_value = store_sized_string(ini_file, edits[i].value, edits[i].value_len);
+            if (edits[i].stored_value == NULL) {
+                error = ini_allocation;
+            }
+        }
     }
-    property = &ini_file->current_section->properties[property_index];
-    /* Moves the properties to insert the new property in the middle, keeping the array sorted by keys */
-    memmove((property + 1), property, (ini_file->current_section->properties_size - property_index)*sizeof(struct Key_Value_Pair));
-    /* Update the values to the new property */
-    property->key = copied_key;
-    property->value = copied_value;
-    ini_file->current_section->properties_size++;
-    return ini_no_error;
-}
-
-Ini_File_Error ini_file_add_property(struct Ini_File *const ini_file, const char *const key, const char *const value) {
-    if (key == NULL) {
-        return ini_key_not_provided;
+    if (error == ini_no_error) {
+        error = (same_size && (flags & ini_patch_in_place)) ?
+            ini_file_patch_in_place(filename, edits, patches_size) :
+            ini_file_patch_splice(filename, data, size, edits, patches_size);
     }
-    if (value == NULL) {
-        return ini_value_not_provided;
+    unmap_file(data, size);
+    if ((error == ini_no_error) && mapped) {
+        error = ini_file_remap_source(ini_file, filename, edits, patches_size);
     }
-    return ini_file_add_property_sized(ini_file, key, strlen(key), value, strlen(value));
-}
-
-Ini_File_Error ini_file_save(const struct Ini_File *const ini_file, const char *const filename) {
-    FILE *file;
-    if (ini_file == NULL) {
-        return ini_invalid_parameters;
+    if (error != ini_no_error) {
+        for (i = 0; i < patches_size; i++) {
+            if (edits[i].stored_value != NULL) {
+                free_string(ini_file, edits[i].stored_value, edits[i].value_len);
+            }
+        }
+        free(edits);
+        return error;
     }
-    file = fopen(filename, "wb");
-	if (file == NULL) {
-        return ini_couldnt_open_file;
+    /* The structure is updated to match the new content of the file */
+    ini_section_shift_offsets(&ini_file->global_section, edits, patches_size);
+    for (i = 0; i < ini_file->sections_size; i++) {
+        ini_section_shift_offsets(&ini_file->sections[i], edits, patches_size);
     }
-    ini_file_print_to(ini_file, file);
-    fclose(file);
+    for (i = 0; i < patches_size; i++) {
+        if (!mapped) {
+            free_string(ini_file, edits[i].property->value, edits[i].property->value_len);
+            edits[i].property->value = edits[i].stored_value;
+        }
+        edits[i].property->value_len = edits[i].value_len;
+    }
+    ini_file_clear_caches(ini_file);
+    free(edits);
     return ini_no_error;
 }
 
+Ini_File_Error ini_file_patch(struct Ini_File *const ini_file, const char *const filename, const Ini_Patch *const patches, const size_t patches_size) {
+    return ini_file_patch_with_flags(ini_file, filename, patches, patches_size, ini_patch_default);
+}
+
 /*------------------------------------------------------------------------------
  * END
  *------------------------------------------------------------------------------
@@ -51,46 +51,116 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/* Some features, such as the memory-mapped parsing of files, rely on POSIX system calls.
+ * They are enabled automatically on POSIX systems. Otherwise, portable implementations
+ * based only on the standard C library are used instead. */
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#define USE_POSIX_SYSTEM_CALLS
+#endif
+
+/* The parallel parser (function ini_file_parse_parallel) uses POSIX threads, so the programs
+ * must be linked with -pthread. Comment the definition of the macro USE_POSIX_THREADS bellow
+ * if you don't want this dependency, in which case the chunks are parsed sequentially. */
+#ifdef USE_POSIX_SYSTEM_CALLS
+#define USE_POSIX_THREADS
+#endif
+
+/* The cache of the converted values, the shared memory (ini_file_publish) and the reloader
+ * use the atomic builtins of GCC and Clang, which are also available in C89 mode. With the
+ * other compilers the values aren't cached, and the shared memory and the reloader aren't
+ * available. */
+#if defined(__GNUC__) || defined(__clang__)
+#define USE_ATOMIC_OPERATIONS
+#endif
+
 /* This is a implementation of a custom string allocator to store the strings found
  * inside the INI. If you don't want to use this approach, just comment the
- * definition of the macro USE_CUSTOM_STRING_ALLOCATOR bellow. In this case, all the
- * string allocations will be performed by expensive malloc calls.
+ * definition of the macro USE_CUSTOM_STRING_ALLOCATOR bellow, or define the macro
+ * INI_NO_CUSTOM_STRING_ALLOCATOR when compiling. In this case, all the string
+ * allocations will be performed by expensive malloc calls.
  * 
  * This custom string allocator consists of a linked-list of large buffers. It is
  * designed to be memory-efficient and avoid memory fragmentation. Whenever a new
  * string is found in the INI file, it is copied to an available buffer in the
  * linked list, allocating new buffers as needed. This approach reduces the number
  * of malloc and free calls, which can be expensive in terms of performance.
+ * The size of the buffers doubles each time a new one is needed, starting from
+ * STRING_ALLOCATOR_FIRST_BUFFER_SIZE up to STRING_ALLOCATOR_MAX_BUFFER_SIZE, so small
+ * files don't pay for a large buffer. The strings larger than a quarter of
+ * STRING_ALLOCATOR_BUFFER_SIZE (or of the next buffer, if it's larger) get a buffer of
+ * their own, so there is no limit on the size of the strings.
  */
+#ifndef INI_NO_CUSTOM_STRING_ALLOCATOR
 #define USE_CUSTOM_STRING_ALLOCATOR
+#endif
 #ifdef USE_CUSTOM_STRING_ALLOCATOR
 
+#define STRING_ALLOCATOR_FIRST_BUFFER_SIZE 256
 #define STRING_ALLOCATOR_BUFFER_SIZE 4096
+#define STRING_ALLOCATOR_MAX_BUFFER_SIZE 65536
 
+/* Header of the buffers, which is followed by the size bytes where the strings are stored */
 struct String_Buffer {
-    char buffer[STRING_ALLOCATOR_BUFFER_SIZE];
     struct String_Buffer *next;
+    size_t size;
 };
 #endif
 
+/* The lengths of the strings are stored alongside them. In the zero-copy mode (see the
+ * flag ini_zero_copy bellow) the strings point to the buffer provided by the user and
+ * are not null-terminated, so the lengths must be used to access them. */
 typedef struct Key_Value_Pair {
     char *key;
     char *value;
+    size_t key_len;
+    size_t value_len;
+    /* Line of the INI file in which this property was declared.
+     * It's zero for the properties added by the ini_file_add_* functions. */
+    size_t line_number;
+    /* Offset of the value from the beginning of the INI file, used by ini_file_patch.
+     * It's only valid if line_number isn't zero. */
+    size_t value_offset;
 } Key_Value_Pair;
 
 typedef struct Ini_Section {
     char *name;
+    size_t name_len;
     /* The properties of the section are stored in a dynamic array */
     size_t properties_size;
     size_t properties_capacity;
     Key_Value_Pair *properties;
+    /* Optional hash table used to find the properties (see the flag ini_hash_index) */
+    size_t properties_index_capacity;
+    size_t *properties_index;
+    /* Values converted by the find functions of numbers, booleans, sizes and durations, in
+     * an array parallel to the properties, with the same capacity. It's allocated by the
+     * allocator of the structure when the properties are inserted, at the end of the bulk
+     * load and by ini_file_resolve, never by the find functions, which only fill it. */
+    struct Ini_Cached_Value *cached_values;
 } Ini_Section;
 
+/* Functions used to allocate all the memory owned by an Ini_File (see the function
+ * ini_file_new_with_allocator). They have the same semantics of malloc, realloc and free,
+ * so reallocate may receive NULL, and receive the context as their first parameter. */
+typedef struct Ini_Allocator {
+    void *(*allocate)(void *const context, const size_t size);
+    void *(*reallocate)(void *const context, void *const ptr, const size_t size);
+    void (*release)(void *const context, void *const ptr);
+    void *context;
+} Ini_Allocator;
+
 typedef struct Ini_File {
 #ifdef USE_CUSTOM_STRING_ALLOCATOR
     struct String_Buffer *strings;
     /* This index points to the next valid location in the buffer to store the string. */
     size_t string_index;
+    /* Size of the next buffer to be allocated */
+    size_t strings_buffer_size;
+    /* Strings released by the ini_file_set_* and ini_file_remove_* functions, kept by size
+     * class to be reused by the next strings stored. Allocated when needed. */
+    struct String_Free_List *free_strings;
+    /* Bytes left unused at the end of the buffers when a new one was allocated */
+    size_t strings_wasted;
 #endif
     /* The global section of the INI file. It's name is always empty */
     struct Ini_Section global_section;
@@ -98,10 +168,66 @@ typedef struct Ini_File {
     size_t sections_size;
     size_t sections_capacity;
     Ini_Section *sections;
+    /* Optional hash table used to find the sections (see the flag ini_hash_index) */
+    size_t sections_index_capacity;
+    size_t *sections_index;
     /* Index of the section in which the properties should be inserted */
     Ini_Section *current_section;
+    /* Flags used to create this structure (see enum Ini_Parse_Flags) */
+    int flags;
+    /* Allocator of the memory of this structure, which uses malloc by default */
+    Ini_Allocator allocator;
+    /* Content of the file referenced by the strings when it is parsed with the flag
+     * ini_memory_map. It is released by ini_file_free */
+    char *source;
+    size_t source_size;
+    /* Counters reported by ini_file_stats */
+    size_t bytes_read;
+    size_t lines_read;
+    double parse_seconds;
+    size_t allocations;
+    size_t bytes_moved;
+    /* Hash set of the strings stored in the interning mode (see the flag ini_intern_strings) */
+    struct Interned_String *interned;
+    size_t interned_size;
+    size_t interned_capacity;
+    size_t interning_saved;
+    /* Version checked by the handles returned by ini_file_resolve. It's given when the first
+     * handle is resolved, and reset to zero when the properties are inserted or removed. */
+    size_t version;
 } Ini_File;
 
+/* Flags that modify the behaviour of the parser. They can be combined with the | operator. */
+typedef enum Ini_Parse_Flags {
+    ini_default_flags = 0,
+    /* The keys, values and section names are not copied, instead they reference the
+     * buffer passed to ini_file_parse_buffer, which must outlive the returned structure.
+     * The strings added later with the ini_file_add_* functions are also referenced
+     * instead of copied. In this mode the strings are not null-terminated. */
+    ini_zero_copy = 1 << 0,
+    /* Used with ini_file_parse_with_flags. The file is mapped in memory (read-only) and
+     * tokenized in place, so it implies ini_zero_copy. The mapping is kept alive until
+     * ini_file_free is called. If the system doesn't support memory-mapped files, the
+     * whole file is read to a buffer instead. */
+    ini_memory_map = 1 << 1,
+    /* The sections and properties are appended to the arrays in the order they are found,
+     * which are sorted only once at the end of the parsing. The repeated keys are detected
+     * and reported at this point, in the order of their lines. The incremental parser
+     * doesn't keep the lines, so it reports the keys instead, in the column zero. This is
+     * faster for sections with many properties. */
+    ini_bulk_load = 1 << 2,
+    /* Builds hash tables at the end of the parsing to find the sections and properties in
+     * constant time. They are kept updated by the ini_file_add_* functions. The arrays are
+     * still sorted, so they can be iterated in order. */
+    ini_hash_index = 1 << 3,
+    /* Each distinct key, value and section name is stored only once, and the repeated ones
+     * share the copy already stored. So they can be compared by their addresses (see the
+     * function ini_file_find_interned). The shared strings are only released by ini_file_free,
+     * so the memory of the values replaced or removed is not reused. It has no effect with
+     * ini_zero_copy and ini_memory_map. */
+    ini_intern_strings = 1 << 4
+} Ini_Parse_Flags;
+
 typedef enum Ini_File_Error {
     ini_no_error = 0,
     ini_allocation,
@@ -118,6 +244,13 @@ typedef enum Ini_File_Error {
     ini_not_integer,
     ini_not_unsigned,
     ini_not_double,
+    ini_parsing_aborted,
+    ini_invalid_compiled_image,
+    ini_stale_handle,
+    ini_not_boolean,
+    ini_not_size,
+    ini_not_duration,
+    ini_line_too_long,
 
     NUMBER_OF_INI_FILE_ERRORS
 } Ini_File_Error;
@@ -127,11 +260,55 @@ typedef enum Ini_File_Error {
  * we end the parsing and return NULL. */
 typedef int (*Ini_File_Error_Callback)(const char *const filename, size_t line_number, size_t column, char *line, enum Ini_File_Error error);
 
+/* Events reported by the event-driven parser (function ini_parse_events) */
+typedef enum Ini_Event_Type {
+    ini_event_section,
+    ini_event_property,
+    ini_event_comment,
+    ini_event_error
+} Ini_Event_Type;
+
+/* The strings of the events point to the buffer in which the line was read, so they are
+ * not null-terminated and are only valid during the call to the handler. */
+typedef struct Ini_Event {
+    Ini_Event_Type type;
+    size_t line_number;
+    /* Column in which the token ends, used to report errors */
+    size_t column;
+    /* The whole line in which the event was found, including the new line character */
+    const char *line;
+    size_t line_len;
+    /* Offset of the beginning of the line from the beginning of the input */
+    size_t offset;
+    /* Section name (ini_event_section), key (ini_event_property) or comment text (ini_event_comment) */
+    const char *name;
+    size_t name_len;
+    /* Value of the property (ini_event_property) */
+    const char *value;
+    size_t value_len;
+    /* Error found while parsing the line (ini_event_error) */
+    Ini_File_Error error;
+} Ini_Event;
+
+/* Handler of the events reported by the event-driven parser. If it returns an integer
+ * different from zero, the parsing is stopped. */
+typedef int (*Ini_Event_Handler)(const Ini_Event *const event, void *const user_data);
+
 size_t get_file_size(FILE *const file);
 /* Remember to free the memory allocated for the returned string */
 char *get_content_from_file(const char *const filename);
 
 Ini_File *ini_file_new(void);
+/* The structure, its arrays, hash tables and strings are allocated by the allocator provided,
+ * which is used until ini_file_free is called. Passing NULL is the same as ini_file_new. */
+Ini_File *ini_file_new_with_allocator(const Ini_Allocator *const allocator);
+/* Initializes an allocator that carves the memory from the region provided by the caller,
+ * which must outlive the structures using it. The allocations fail when the region runs
+ * out, and then the functions of this library return ini_allocation. The memory released
+ * is only reused if it was the last allocated, so the region can be reused as a whole by
+ * initializing the allocator again after ini_file_free. Returns ini_invalid_parameters if
+ * the region is too small. The allocator is not thread-safe. */
+Ini_File_Error ini_allocator_from_region(Ini_Allocator *const allocator, void *const memory, const size_t size);
 void ini_file_free(Ini_File *const ini_file);
 void ini_section_print_to(const Ini_Section *const ini_section, FILE *const sink);
 void ini_file_print_to(const Ini_File *const ini_file, FILE *const sink);
@@ -139,29 +316,400 @@ char *ini_file_error_to_string(const Ini_File_Error error);
 /* This function is usefull for debug purposes */
 void ini_file_info(const Ini_File *const ini_file);
 
+/* Statistics about the parsing and the memory used by an Ini_File, filled by ini_file_stats.
+ * The counters of the parsing are zero for the structures that weren't parsed. */
+typedef struct Ini_File_Stats {
+    /* Bytes and lines of the INI file processed by the parser */
+    size_t bytes_read;
+    size_t lines;
+    /* Time spent parsing, including the sort of the bulk load and the hash tables */
+    double parse_seconds;
+    /* Number of allocations and reallocations made for this structure since it was created */
+    size_t allocations;
+    size_t sections;
+    size_t properties;
+    /* Memory of the custom string allocator (zero if it isn't used). The wasted bytes are the
+     * ones left at the end of the buffers plus the released strings not reused yet. The bytes
+     * still available in the current buffer are neither used nor wasted. */
+    size_t arena_size;
+    size_t arena_used;
+    size_t arena_wasted;
+    /* Bytes moved to keep the arrays sorted when inserting and removing elements */
+    size_t bytes_moved;
+    /* Bytes allocated for the arrays and hash tables, but not used yet */
+    size_t capacity_slack;
+    /* Distinct strings stored in the interning mode, and the bytes that the repeated ones
+     * would have taken if they were copied */
+    size_t interned_strings;
+    size_t interned_bytes_saved;
+    /* Section with the largest number of properties (the global section has an empty name) */
+    const char *largest_section;
+    size_t largest_section_len;
+    size_t largest_section_properties;
+} Ini_File_Stats;
+
+Ini_File_Error ini_file_stats(const Ini_File *const ini_file, Ini_File_Stats *const stats);
+
 /* Remember to free the memory allocated for the returned ini file structure */
 Ini_File *ini_file_parse(const char *const filename, Ini_File_Error_Callback callback);
+/* The flags parameter is a combination of Ini_Parse_Flags */
+Ini_File *ini_file_parse_with_flags(const char *const filename, const int flags, Ini_File_Error_Callback callback);
+/* Same as ini_file_parse_with_flags, but the structure and the buffers used to read the file
+ * are allocated by the allocator provided (see ini_file_new_with_allocator). The mapping of
+ * the file used with the flag ini_memory_map isn't allocated by it. */
+Ini_File *ini_file_parse_with_allocator(const char *const filename, const int flags, const Ini_Allocator *const allocator, Ini_File_Error_Callback callback);
+/* These functions report the sections, properties, comments and errors found in the INI file
+ * to the handler, without building any data structure. The file is read line by line, so the
+ * memory used doesn't depend on its size. They return ini_no_error = 0 if the file could be
+ * read, even if the handler stopped the parsing. */
+Ini_File_Error ini_parse_events(const char *const filename, Ini_Event_Handler handler, void *const user_data);
+Ini_File_Error ini_parse_events_buffer(const char *const data, const size_t len, Ini_Event_Handler handler, void *const user_data);
+/* Incremental (push) parser, which accepts the content of the INI file in chunks of any size,
+ * for instance, as they are received from pipes or sockets. Only the unfinished line is kept
+ * between the calls to ini_parser_feed. The flags parameter is a combination of
+ * Ini_Parse_Flags, except ini_zero_copy and ini_memory_map, which are ignored.
+ * ini_parser_feed returns ini_parsing_aborted if the callback asked to stop the parsing.
+ * If the unfinished line can't be stored, it returns ini_allocation, and so do the next
+ * calls, which ignore their input. The lines longer than INI_PARSER_MAX_LINE_LENGTH bytes
+ * (not counting the new line character) are refused in the same way with ini_line_too_long,
+ * so a stream without new lines can't make the parser grow without bound. This limit can be
+ * changed with ini_parser_set_max_line_length, before the first call to ini_parser_feed,
+ * and zero means no limit. ini_parser_finish releases the parser and returns the same
+ * structure that ini_file_parse would build, or NULL if the parsing was aborted or failed. */
+#define INI_PARSER_MAX_LINE_LENGTH (1024 * 1024)
+typedef struct Ini_Parser Ini_Parser;
+Ini_Parser *ini_parser_new(const int flags, Ini_File_Error_Callback callback);
+/* Same as ini_parser_new, but the parser, its unfinished line and the structure are
+ * allocated by the allocator provided (see ini_file_new_with_allocator) */
+Ini_Parser *ini_parser_new_with_allocator(const int flags, const Ini_Allocator *const allocator, Ini_File_Error_Callback callback);
+Ini_File_Error ini_parser_set_max_line_length(Ini_Parser *const parser, const size_t max_line_length);
+Ini_File_Error ini_parser_feed(Ini_Parser *const parser, const char *const data, const size_t len);
+Ini_File *ini_parser_finish(Ini_Parser *const parser);
+/* Parses a large INI file using several threads. The file is split in chunks at the
+ * declarations of sections, which are parsed in parallel, and the results are merged. The
+ * flag ini_bulk_load is always used. The errors are reported after all the chunks are
+ * parsed, in the order they appear in the file. If threads is zero, the number of processors
+ * available is used. */
+Ini_File *ini_file_parse_parallel(const char *const filename, const size_t threads, const int flags, Ini_File_Error_Callback callback);
+/* Same as ini_file_parse_parallel, but the structure, including the partial structures built by
+ * each thread, is allocated by the allocator provided (see ini_file_new_with_allocator). The
+ * threads call the allocator at the same time, so it must be thread-safe. The allocators of
+ * ini_allocator_from_region aren't, so they must be used with a single thread (threads = 1). */
+Ini_File *ini_file_parse_parallel_with_allocator(const char *const filename, const size_t threads, const int flags, const Ini_Allocator *const allocator, Ini_File_Error_Callback callback);
+/* Parses the INI file stored in memory at data, with a size of len bytes. The data doesn't
+ * need to be null-terminated. The flags parameter is a combination of Ini_Parse_Flags. */
+Ini_File *ini_file_parse_buffer(const char *const data, const size_t len, const int flags, Ini_File_Error_Callback callback);
+/* Same as ini_file_parse_buffer, but all the memory of the structure is allocated by the
+ * allocator provided (see ini_file_new_with_allocator). No other memory is allocated. */
+Ini_File *ini_file_parse_buffer_with_allocator(const char *const data, const size_t len, const int flags, const Ini_Allocator *const allocator, Ini_File_Error_Callback callback);
 
 /* These functions use binary search algorithm to find the requested section and properties.
  * They return ini_no_error = 0 if everything worked correctly.
  * The found value will be stored at the memory address provided by the caller.
- * Note that the function may modify the value stored at the address provided even if the section/property isn't found. */
+ * Note that the function may modify the value stored at the address provided even if the section/property isn't found.
+ * The values are converted by the ini_convert_* functions, not by strtol, strtoul and strtod: the integers may
+ * have the prefixes 0x, 0o and 0b, the ones that overflow are rejected instead of clamped, and the negative ones
+ * are rejected by ini_file_find_unsigned instead of wrapped around. The spaces around the values aren't accepted. */
 Ini_File_Error ini_file_find_section(Ini_File *const ini_file, const char *const section, Ini_Section **const ini_section);
 Ini_File_Error ini_file_find_property(Ini_File *const ini_file, const char *const section, const char *const key, char **const value);
 Ini_File_Error ini_file_find_integer(Ini_File *const ini_file, const char *const section, const char *const key, long *const integer);
 Ini_File_Error ini_file_find_unsigned(Ini_File *const ini_file, const char *const section, const char *const key, unsigned long *const uint);
 Ini_File_Error ini_file_find_double(Ini_File *const ini_file, const char *const section, const char *const key, double *const real);
+Ini_File_Error ini_file_find_boolean(Ini_File *const ini_file, const char *const section, const char *const key, int *const boolean);
+Ini_File_Error ini_file_find_size(Ini_File *const ini_file, const char *const section, const char *const key, unsigned long *const size);
+Ini_File_Error ini_file_find_duration(Ini_File *const ini_file, const char *const section, const char *const key, double *const seconds);
 Ini_File_Error ini_section_find_property(Ini_Section *const ini_section, const char *const key, char **const value);
+/* These functions return the whole key value pair, so the lengths of the strings are available */
+Ini_File_Error ini_file_find_pair(Ini_File *const ini_file, const char *const section, const char *const key, Key_Value_Pair **const property);
+Ini_File_Error ini_section_find_pair(Ini_Section *const ini_section, const char *const key, Key_Value_Pair **const property);
 Ini_File_Error ini_section_find_integer(Ini_Section *const ini_section, const char *const key, long *const integer);
 Ini_File_Error ini_section_find_unsigned(Ini_Section *const ini_section, const char *const key, unsigned long *const uint);
 Ini_File_Error ini_section_find_double(Ini_Section *const ini_section, const char *const key, double *const real);
+Ini_File_Error ini_section_find_boolean(Ini_Section *const ini_section, const char *const key, int *const boolean);
+Ini_File_Error ini_section_find_size(Ini_Section *const ini_section, const char *const key, unsigned long *const size);
+Ini_File_Error ini_section_find_duration(Ini_Section *const ini_section, const char *const key, double *const seconds);
+/* The find functions of numbers, booleans, sizes and durations cache the first conversion of
+ * each value, which is reused by the next calls of the same type. The cache is cleared when
+ * the value is changed by this library, so this function must be called if the values of
+ * the section are changed directly. */
+void ini_section_clear_cache(Ini_Section *const ini_section);
+
+/* Iterators over the properties of a section and over the sections of a file, which are
+ * sorted by their names. The prefix functions select the names starting with the prefix,
+ * and the range functions the names from low (inclusive) to high (exclusive), where NULL
+ * means no bound. The start and the end are found by binary searches, so no memory is
+ * allocated and the iteration takes time proportional to the number of elements selected.
+ * The next functions return NULL after the last element. The iterators are invalidated
+ * when the sections or properties are inserted or removed, and the global section isn't
+ * included in the iteration over the sections. Their fields are private.
+ * The properties aren't sorted during a bulk load, in which case the ini_file_iter_*
+ * functions return ini_invalid_parameters. The ini_section_iter_* functions can't check it,
+ * so, like the ini_section_find_* functions, they must not be used until it ends. The
+ * ini_file_iter_properties_* functions find the section by its name, where NULL or an
+ * empty string selects the global section. */
+typedef struct Ini_Property_Iterator {
+    Key_Value_Pair *properties;
+    size_t index;
+    size_t end;
+} Ini_Property_Iterator;
+
+typedef struct Ini_Section_Iterator {
+    Ini_Section *sections;
+    size_t index;
+    size_t end;
+} Ini_Section_Iterator;
+
+Ini_File_Error ini_section_iter_prefix(Ini_Section *const ini_section, const char *const prefix, Ini_Property_Iterator *const iterator);
+Ini_File_Error ini_section_iter_range(Ini_Section *const ini_section, const char *const low, const char *const high, Ini_Property_Iterator *const iterator);
+Ini_File_Error ini_file_iter_properties_prefix(Ini_File *const ini_file, const char *const section, const char *const prefix, Ini_Property_Iterator *const iterator);
+Ini_File_Error ini_file_iter_properties_range(Ini_File *const ini_file, const char *const section, const char *const low, const char *const high, Ini_Property_Iterator *const iterator);
+Key_Value_Pair *ini_property_iter_next(Ini_Property_Iterator *const iterator);
+Ini_File_Error ini_file_iter_sections_prefix(Ini_File *const ini_file, const char *const prefix, Ini_Section_Iterator *const iterator);
+Ini_File_Error ini_file_iter_sections_range(Ini_File *const ini_file, const char *const low, const char *const high, Ini_Section_Iterator *const iterator);
+Ini_Section *ini_section_iter_next(Ini_Section_Iterator *const iterator);
+
+/* Types of the values found by ini_file_find_many */
+typedef enum Ini_Value_Type {
+    /* The result is a char * with the value of the property, as in ini_file_find_property */
+    ini_value_string,
+    /* The results are converted as in the functions ini_file_find_<type> */
+    ini_value_integer,
+    ini_value_unsigned,
+    ini_value_double,
+    ini_value_boolean,
+    ini_value_size,
+    ini_value_duration
+} Ini_Value_Type;
+
+/* Query of ini_file_find_many. The section, key, type and result are provided by the caller,
+ * where result points to the variable of the type in which the value is stored (e.g. a long
+ * for ini_value_integer), or is NULL if only the property is needed. The property and the
+ * error of each query are filled by ini_file_find_many. */
+typedef struct Ini_Query {
+    const char *section;
+    const char *key;
+    Ini_Value_Type type;
+    void *result;
+    Key_Value_Pair *property;
+    Ini_File_Error error;
+} Ini_Query;
+
+/* Finds many properties at once. The queries are sorted by section and key in batches of
+ * 32, without allocating memory, so each section is searched only once per batch, and its
+ * properties are found in a single pass over the sorted array. Returns ini_no_error = 0 if
+ * all the queries succeeded, otherwise the error of the first query that failed. */
+Ini_File_Error ini_file_find_many(Ini_File *const ini_file, Ini_Query *const queries, const size_t queries_size);
+
+/* Conversions of the values used by the find functions, which don't depend on the locale.
+ * The strings don't need to be null-terminated. The integers may have a sign and one of the
+ * prefixes 0x, 0o and 0b (hexadecimal, octal and binary), and are rejected if they overflow.
+ * The numbers are always written with a '.' as the decimal point. The booleans are true,
+ * yes, on and 1, or false, no, off and 0, in any case. The sizes are decimal integers,
+ * without prefixes, followed by one of the suffixes K, M, G, T, P or E (powers of 1024),
+ * optionally followed by B or iB (e.g. 64K, 1GiB). The durations are numbers of seconds,
+ * or numbers followed by one of the units ns, us, ms, s, m or min, h and d (e.g. 250ms,
+ * 1.5h), where the number has only decimal digits and an optional fraction. The numbers are
+ * always correctly rounded, and may also be inf, infinity or nan, but not hexadecimal. */
+Ini_File_Error ini_convert_integer(const char *const value, const size_t value_len, long *const integer);
+Ini_File_Error ini_convert_unsigned(const char *const value, const size_t value_len, unsigned long *const uint);
+Ini_File_Error ini_convert_double(const char *const value, const size_t value_len, double *const real);
+Ini_File_Error ini_convert_boolean(const char *const value, const size_t value_len, int *const boolean);
+Ini_File_Error ini_convert_size(const char *const value, const size_t value_len, unsigned long *const size);
+Ini_File_Error ini_convert_duration(const char *const value, const size_t value_len, double *const seconds);
+
+/* Handle of a property, returned by ini_file_resolve, which finds the property only once. The
+ * ini_handle_get_* functions then access it directly, without searching the strings. Its
+ * fields are private. The handles are invalidated when any property of the structure is
+ * inserted or removed, after which these functions return ini_stale_handle, so the handle
+ * must be resolved again. The handles are never accepted by another structure, such as
+ * the one parsed again when the file is reloaded. The values changed by ini_file_set_property
+ * and ini_file_patch are seen through the handles. The version check is not synchronized:
+ * the ini_handle_get_* functions may run at the same time as each other and as the find
+ * functions, but never at the same time as the functions that modify the structure (add,
+ * set, remove, patch, bulk load) or as ini_file_resolve, which must be synchronized by the
+ * caller like any other change of the structure. */
+typedef struct Ini_Handle {
+    size_t version;
+    Key_Value_Pair *property;
+    struct Ini_Cached_Value *cached_value;
+} Ini_Handle;
+
+Ini_File_Error ini_file_resolve(Ini_File *const ini_file, const char *const section, const char *const key, Ini_Handle *const handle);
+Ini_File_Error ini_handle_get_property(const Ini_File *const ini_file, const Ini_Handle *const handle, char **const value);
+Ini_File_Error ini_handle_get_integer(const Ini_File *const ini_file, const Ini_Handle *const handle, long *const integer);
+Ini_File_Error ini_handle_get_unsigned(const Ini_File *const ini_file, const Ini_Handle *const handle, unsigned long *const uint);
+Ini_File_Error ini_handle_get_double(const Ini_File *const ini_file, const Ini_Handle *const handle, double *const real);
+Ini_File_Error ini_handle_get_boolean(const Ini_File *const ini_file, const Ini_Handle *const handle, int *const boolean);
+Ini_File_Error ini_handle_get_size(const Ini_File *const ini_file, const Ini_Handle *const handle, unsigned long *const size);
+Ini_File_Error ini_handle_get_duration(const Ini_File *const ini_file, const Ini_Handle *const handle, double *const seconds);
 
 /* These functions returns ini_no_error = 0 if everything worked correctly */
 Ini_File_Error ini_file_add_section_sized(Ini_File *const ini_file, const char *const name, const size_t name_len);
 Ini_File_Error ini_file_add_section(Ini_File *const ini_file, const char *const name);
 Ini_File_Error ini_file_add_property_sized(Ini_File *const ini_file, const char *const key, const size_t key_len, const char *const value, const size_t value_len);
 Ini_File_Error ini_file_add_property(Ini_File *const ini_file, const char *const key, const char *const value);
+/* These functions find the section by its name, where NULL or an empty string selects the
+ * global section. ini_file_set_property changes the value of the property, which is added
+ * if it doesn't exist yet, as well as its section. It returns ini_invalid_parameters for
+ * structures in the zero-copy mode (ini_zero_copy or ini_memory_map), in which the new value
+ * would reference the memory of the caller. The current section used by the
+ * ini_file_add_* functions isn't changed. ini_file_remove_section removes the section and
+ * all its properties, but the global section is only emptied. */
+Ini_File_Error ini_file_set_property(Ini_File *const ini_file, const char *const section, const char *const key, const char *const value);
+Ini_File_Error ini_file_remove_property(Ini_File *const ini_file, const char *const section, const char *const key);
+Ini_File_Error ini_file_remove_section(Ini_File *const ini_file, const char *const section);
+/* Between these calls, the ini_file_add_* functions just append the sections and properties
+ * to the arrays, which are sorted at once by ini_file_bulk_end. The find functions must not
+ * be used until ini_file_bulk_end is called. The repeated keys are reported to the callback
+ * (if provided), with the key as the line and in the column zero, and discarded, in which
+ * case ini_file_bulk_end returns ini_repeated_key. */
+Ini_File_Error ini_file_bulk_begin(Ini_File *const ini_file);
+Ini_File_Error ini_file_bulk_end(Ini_File *const ini_file, Ini_File_Error_Callback callback);
+/* ini_file_save renders the whole file to a single buffer and writes it to a temporary
+ * file, which replaces the destination only after it's flushed to the disk, so a crash
+ * never leaves the destination truncated. The directory is flushed after the rename too.
+ * The owner, group and permissions of the destination are kept (the owner only if the
+ * process is allowed to change it), and the new files get the permissions of fopen (0666
+ * restricted by the umask). If the destination is a symbolic link, the link is kept and the
+ * file it references is replaced.
+ * ini_file_save_with_buffer uses the buffer provided, if it's large enough for the output,
+ * instead of allocating one. */
 Ini_File_Error ini_file_save(const Ini_File *const ini_file, const char *const filename);
+Ini_File_Error ini_file_save_with_buffer(const Ini_File *const ini_file, const char *const filename, char *const buffer, const size_t buffer_size);
+/* Returns the exact size of the text written by ini_file_print_to and ini_file_save */
+size_t ini_file_serialized_size(const Ini_File *const ini_file);
+/* Writes the same text of ini_file_save to the buffer, which isn't null-terminated. The
+ * size of the text is stored at size. If the buffer is NULL or smaller than that, nothing
+ * is written and ini_allocation is returned. */
+Ini_File_Error ini_file_serialize_to_buffer(const Ini_File *const ini_file, char *const buffer, const size_t buffer_size, size_t *const size);
+
+/* Change of the value of a property, applied by ini_file_patch */
+typedef struct Ini_Patch {
+    const char *section;
+    const char *key;
+    const char *value;
+} Ini_Patch;
+
+/* Flags of ini_file_patch_with_flags. They can be combined with the | operator. */
+typedef enum Ini_Patch_Flags {
+    ini_patch_default = 0,
+    /* If all the new values have the same sizes as the old ones, they are written over the
+     * old ones in the file itself, instead of replacing the file. This avoids copying the
+     * file, but it isn't atomic: a crash or a failed write may leave only part of the changes
+     * in the file, and the programs reading it at the same time may see partial changes. */
+    ini_patch_in_place = 1 << 0
+} Ini_Patch_Flags;
+
+/* Changes the values of the properties in the INI file from which the structure was parsed,
+ * preserving the comments and the layout of the file. The regions of the file between the
+ * values are copied in large blocks to a new file, which replaces the old one atomically, as
+ * in ini_file_save. The structure is updated to reflect the new values. The structures parsed
+ * with the flag ini_memory_map are moved to the mapping of the new file, so the strings
+ * previously returned are no longer valid. Returns ini_invalid_parameters if a property
+ * wasn't read from the file (e.g. it was added by the ini_file_add_* functions), if the file
+ * was changed since it was parsed, if the value was changed in memory since it was parsed
+ * (e.g. by ini_file_set_property), because the old value is then compared with the file to
+ * detect its changes, if the same property is changed twice, if a new value can't be stored
+ * in an INI file as it is (it's empty, has comments, new lines or white spaces at its ends),
+ * or if the structure was parsed from a buffer in the zero-copy mode
+ * (ini_zero_copy without ini_memory_map), in which the new values would reference the memory
+ * of the caller. The flags parameter is a combination of Ini_Patch_Flags. */
+Ini_File_Error ini_file_patch(Ini_File *const ini_file, const char *const filename, const Ini_Patch *const patches, const size_t patches_size);
+Ini_File_Error ini_file_patch_with_flags(Ini_File *const ini_file, const char *const filename, const Ini_Patch *const patches, const size_t patches_size, const int flags);
+/* Builds the hash tables described by the flag ini_hash_index for an existing structure */
+Ini_File_Error ini_file_build_index(Ini_File *const ini_file);
+/* Enables the interning mode (see the flag ini_intern_strings) for an existing structure,
+ * releasing the repeated copies of the strings already stored. Returns ini_invalid_parameters
+ * if the strings aren't copied (ini_zero_copy). */
+Ini_File_Error ini_file_intern_strings(Ini_File *const ini_file);
+/* Stores at interned the copy of the string kept by a structure in the interning mode, which
+ * is the same address of all the keys, values and section names equal to it. Returns
+ * ini_no_such_property if no string stored is equal to it, and ini_invalid_parameters if the
+ * structure doesn't use the interning mode. */
+Ini_File_Error ini_file_find_interned(const Ini_File *const ini_file, const char *const str, const char **const interned);
+
+/* Immutable copy of an Ini_File, which is stored in a single contiguous block of memory.
+ * The snapshot is never modified after ini_file_freeze returns, and its query functions
+ * don't use any internal state, so they can be called from any number of threads at the
+ * same time without locking. The strings returned are null-terminated and remain valid
+ * until ini_snapshot_free is called. ini_file_freeze returns NULL if the memory couldn't
+ * be allocated or if it's called between ini_file_bulk_begin and ini_file_bulk_end. */
+typedef struct Ini_Snapshot Ini_Snapshot;
+Ini_Snapshot *ini_file_freeze(const Ini_File *const ini_file);
+void ini_snapshot_free(Ini_Snapshot *const snapshot);
+void ini_snapshot_print_to(const Ini_Snapshot *const snapshot, FILE *const sink);
+/* The length of the value is stored at value_len, if it isn't NULL */
+Ini_File_Error ini_snapshot_find_sized(const Ini_Snapshot *const snapshot, const char *const section, const char *const key, const char **const value, size_t *const value_len);
+Ini_File_Error ini_snapshot_find_property(const Ini_Snapshot *const snapshot, const char *const section, const char *const key, const char **const value);
+Ini_File_Error ini_snapshot_find_integer(const Ini_Snapshot *const snapshot, const char *const section, const char *const key, long *const integer);
+Ini_File_Error ini_snapshot_find_unsigned(const Ini_Snapshot *const snapshot, const char *const section, const char *const key, unsigned long *const uint);
+Ini_File_Error ini_snapshot_find_double(const Ini_Snapshot *const snapshot, const char *const section, const char *const key, double *const real);
+Ini_File_Error ini_snapshot_find_boolean(const Ini_Snapshot *const snapshot, const char *const section, const char *const key, int *const boolean);
+Ini_File_Error ini_snapshot_find_size(const Ini_Snapshot *const snapshot, const char *const section, const char *const key, unsigned long *const size);
+Ini_File_Error ini_snapshot_find_duration(const Ini_Snapshot *const snapshot, const char *const section, const char *const key, double *const seconds);
+/* ini_file_compile writes the snapshot of the INI file to a binary image, including the hash
+ * tables if the structure was built with the flag ini_hash_index. ini_file_open_compiled maps
+ * the image in memory and answers the queries of the ini_snapshot_find_* functions directly
+ * from it, without parsing or allocating memory. The images with a different version, built
+ * for another architecture or damaged (detected by a checksum) are rejected with the error
+ * ini_invalid_compiled_image. The images must be released by ini_compiled_close. The image
+ * is replaced atomically, as in ini_file_save, so the programs that open it while it's being
+ * compiled get either the previous image or the new one. */
+Ini_File_Error ini_file_compile(const Ini_File *const ini_file, const char *const filename);
+Ini_File_Error ini_file_open_compiled(const char *const filename, const Ini_Snapshot **const snapshot);
+void ini_compiled_close(const Ini_Snapshot *const snapshot);
+
+#if defined(USE_POSIX_SYSTEM_CALLS) && defined(USE_ATOMIC_OPERATIONS)
+/* Shares a snapshot of the INI file with other processes through POSIX shared memory. The
+ * name must follow the rules of shm_open, starting with a slash. Each call to
+ * ini_file_publish creates a new generation, which replaces the previous one. Only one
+ * process should publish each name. ini_shared_unlink removes the segments, although the
+ * processes attached keep their mappings. The segments are created with the permissions 0600,
+ * so only the processes of the same user can attach to them. ini_file_publish_with_mode
+ * creates them with the permissions provided (e.g. 0640 or 0644), to share them with other
+ * users. The permissions aren't restricted by the umask, and they are also applied to the
+ * control segment of a name published before.
+ * The other processes call ini_shared_attach to map the latest generation in read-only
+ * mode, and query it using the ini_snapshot_find_* functions on the snapshot returned by
+ * ini_shared_snapshot. ini_shared_refresh switches to the latest generation, if a newer
+ * one was published, after which the snapshots previously returned are no longer valid.
+ * So, if several threads use the same Ini_Shared, the refresh must be synchronized with
+ * them. ini_shared_attach returns NULL if nothing was published with the name. */
+typedef struct Ini_Shared Ini_Shared;
+Ini_File_Error ini_file_publish(const Ini_File *const ini_file, const char *const name);
+Ini_File_Error ini_file_publish_with_mode(const Ini_File *const ini_file, const char *const name, const unsigned int mode);
+Ini_File_Error ini_shared_unlink(const char *const name);
+Ini_Shared *ini_shared_attach(const char *const name);
+void ini_shared_detach(Ini_Shared *const shared);
+const Ini_Snapshot *ini_shared_snapshot(const Ini_Shared *const shared);
+Ini_File_Error ini_shared_refresh(Ini_Shared *const shared);
+#endif
+
+#if defined(USE_POSIX_THREADS) && defined(USE_ATOMIC_OPERATIONS)
+/* Keeps the most recent snapshot of an INI file, which is reloaded when the file changes.
+ * The changes are detected by polling the inode, size and modification time of the file,
+ * either by calling ini_reloader_check or by the background thread started with
+ * ini_reloader_start, which checks the file every interval milliseconds (an interval of
+ * zero is rejected with ini_invalid_parameters). A reload can
+ * also be forced with ini_reloader_reload, or requested to the background thread with
+ * ini_reloader_request, which is safe to call from a signal handler (e.g. SIGHUP). If the
+ * new version can't be parsed, the errors are reported to the callback and the previous
+ * snapshot is kept.
+ * The readers get the current snapshot with ini_reloader_acquire, which never blocks,
+ * and must call ini_reloader_release with the epoch it stored when they are done. The old
+ * snapshots are released only after all their readers are done, so the reloads may wait
+ * for them. The reloader must not be released while there are readers using it. */
+typedef struct Ini_Reloader Ini_Reloader;
+Ini_Reloader *ini_reloader_new(const char *const filename, const int flags, Ini_File_Error_Callback callback);
+void ini_reloader_free(Ini_Reloader *const reloader);
+Ini_File_Error ini_reloader_check(Ini_Reloader *const reloader);
+Ini_File_Error ini_reloader_reload(Ini_Reloader *const reloader);
+void ini_reloader_request(Ini_Reloader *const reloader);
+Ini_File_Error ini_reloader_start(Ini_Reloader *const reloader, const unsigned long interval);
+void ini_reloader_stop(Ini_Reloader *const reloader);
+const Ini_Snapshot *ini_reloader_acquire(Ini_Reloader *const reloader, int *const epoch);
+void ini_reloader_release(Ini_Reloader *const reloader, const int epoch);
+#endif
 
 #endif  /* __INI_FILE */
 